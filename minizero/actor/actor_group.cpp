@@ -3,6 +3,8 @@
 #include "create_actor.h"
 #include "create_network.h"
 #include "random.h"
+#include "utils.h"
+#include "wire_frame.h"
 #include <algorithm>
 #include <iostream>
 #include <memory>
@@ -15,26 +17,30 @@ namespace minizero::actor {
 using namespace network;
 using namespace utils;
 
-int ThreadSharedData::getAvailableActorIndex()
-{
-    std::lock_guard lock(mutex_);
-    return (actor_index_ < static_cast<int>(actors_.size()) ? actor_index_++ : actors_.size());
-}
-
 void ThreadSharedData::outputGame(const std::shared_ptr<BaseActor>& actor)
 {
     int game_length = actor->getEnvironment().getActionHistory().size();
     std::pair<int, int> data_range = calculateTrainingDataRange(actor);
 
-    std::ostringstream oss;
     bool is_terminal = (config::zero_actor_intermediate_sequence_length == 0 || actor->isEnvTerminal());
-    oss << "SelfPlay "
-        << (is_terminal ? "true" : "false") << " "                                                                         // is terminal
-        << (data_range.second - data_range.first + 1) << " "                                                               // data length
-        << game_length << " "                                                                                              // game length
-        << actor->getEnvironment().getEvalScore(!actor->isEnvTerminal()) << " "                                            // return
-        << actor->getRecord({{"DLEN", std::to_string(data_range.first) + "-" + std::to_string(data_range.second)}}) << " " // game record
-        << "#";                                                                                                            // end mark for a valid game
+    std::string game;
+    if (config::zero_actor_binary_protocol) {
+        game = utils::toWireSelfPlayPayload(is_terminal,
+                                            data_range.second - data_range.first + 1,
+                                            game_length,
+                                            actor->getEnvironment().getEvalScore(!actor->isEnvTerminal()),
+                                            actor->getRecord({{"DLEN", std::to_string(data_range.first) + "-" + std::to_string(data_range.second)}}));
+    } else {
+        std::ostringstream oss;
+        oss << "SelfPlay "
+            << (is_terminal ? "true" : "false") << " "                                                                         // is terminal
+            << (data_range.second - data_range.first + 1) << " "                                                               // data length
+            << game_length << " "                                                                                              // game length
+            << actor->getEnvironment().getEvalScore(!actor->isEnvTerminal()) << " "                                            // return
+            << actor->getRecord({{"DLEN", std::to_string(data_range.first) + "-" + std::to_string(data_range.second)}}) << " " // game record
+            << "#";                                                                                                            // end mark for a valid game
+        game = oss.str();
+    }
 
     if (!is_terminal) {
         // delete action info history if not complete record to save memory
@@ -45,8 +51,7 @@ void ThreadSharedData::outputGame(const std::shared_ptr<BaseActor>& actor)
         }
     }
 
-    std::lock_guard lock(mutex_);
-    std::cout << oss.str() << std::endl;
+    game_writer_.write(std::move(game));
 }
 
 std::pair<int, int> ThreadSharedData::calculateTrainingDataRange(const std::shared_ptr<BaseActor>& actor)
@@ -60,6 +65,13 @@ std::pair<int, int> ThreadSharedData::calculateTrainingDataRange(const std::shar
     return {data_start, data_end};
 }
 
+void ThreadSharedData::updatePhaseTime(double& phase_time)
+{
+    double elapsed_time = (TimeSystem::getLocalTime() - round_start_time_).total_microseconds();
+    std::lock_guard lock(mutex_);
+    phase_time = std::max(phase_time, elapsed_time);
+}
+
 void SlaveThread::initialize()
 {
     int seed = config::program_auto_seed ? std::random_device()() : config::program_seed + id_;
@@ -68,44 +80,61 @@ void SlaveThread::initialize()
 
 void SlaveThread::runJob()
 {
-    if (getSharedData()->do_cpu_job_) {
-        while (doCPUJob()) {}
-    } else {
+    // threads that forward the networks join the CPU jobs of the other cohort after the forward is done
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    if (shared_data->gpu_cohort_ != -1 && id_ < shared_data->getNumNetworksPerCohort()) {
         doGPUJob();
+        shared_data->updatePhaseTime(shared_data->gpu_phase_time_);
+    }
+    if (shared_data->cpu_cohort_ != -1) {
+        actor_chunk_ = {0, 0};
+        while (doCPUJob()) {}
+        shared_data->updatePhaseTime(shared_data->cpu_phase_time_);
+    }
+}
+
+int SlaveThread::getAvailableActorIndex()
+{
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    if (actor_chunk_.first == actor_chunk_.second) {
+        actor_chunk_ = shared_data->actor_dispenser_.getNextChunk();
+        if (actor_chunk_.first == actor_chunk_.second) { return shared_data->actors_.size(); }
     }
+    return shared_data->cpu_cohort_ + (actor_chunk_.first++) * shared_data->getNumCohorts();
 }
 
 bool SlaveThread::doCPUJob()
 {
-    size_t actor_id = getSharedData()->getAvailableActorIndex();
+    size_t actor_id = getAvailableActorIndex();
     if (actor_id >= getSharedData()->actors_.size()) { return false; }
 
     std::shared_ptr<BaseActor>& actor = getSharedData()->actors_[actor_id];
-    int network_id = actor_id % getSharedData()->networks_.size();
+    int network_id = getSharedData()->getNetworkIndex(actor_id);
     int network_output_id = actor->getNNEvaluationBatchIndex();
     if (network_output_id >= 0) {
         assert(network_output_id < static_cast<int>(getSharedData()->network_outputs_[network_id].size()));
         actor->afterNNEvaluation(getSharedData()->network_outputs_[network_id][network_output_id]);
-        if (actor->isSearchDone()) { handleSearchDone(actor_id); }
     }
+    if (actor->isSearchDone()) { handleSearchDone(actor_id); } // the search may also be done by the NN evaluation cache in beforeNNEvaluation()
     actor->beforeNNEvaluation();
     return true;
 }
 
 void SlaveThread::doGPUJob()
 {
-    if (id_ >= static_cast<int>(getSharedData()->networks_.size())) { return; }
+    if (id_ >= getSharedData()->getNumNetworksPerCohort()) { return; }
 
-    std::shared_ptr<Network>& network = getSharedData()->networks_[id_];
+    int network_id = getSharedData()->gpu_cohort_ * getSharedData()->getNumNetworksPerCohort() + id_;
+    std::shared_ptr<Network>& network = getSharedData()->networks_[network_id];
     if (network->getNetworkTypeName() == "alphazero") {
         std::shared_ptr<AlphaZeroNetwork> az_network = std::static_pointer_cast<AlphaZeroNetwork>(network);
-        if (az_network->getBatchSize() > 0) { getSharedData()->network_outputs_[id_] = az_network->forward(); }
+        if (az_network->getBatchSize() > 0) { getSharedData()->network_outputs_[network_id] = az_network->forward(); }
     } else if (network->getNetworkTypeName() == "muzero" || network->getNetworkTypeName() == "muzero_atari") {
         std::shared_ptr<MuZeroNetwork> muzero_network = std::static_pointer_cast<MuZeroNetwork>(network);
         if (muzero_network->getInitialInputBatchSize() > 0) {
-            getSharedData()->network_outputs_[id_] = std::static_pointer_cast<MuZeroNetwork>(network)->initialInference();
+            getSharedData()->network_outputs_[network_id] = std::static_pointer_cast<MuZeroNetwork>(network)->initialInference();
         } else if (muzero_network->getRecurrentInputBatchSize() > 0) {
-            getSharedData()->network_outputs_[id_] = std::static_pointer_cast<MuZeroNetwork>(network)->recurrentInference();
+            getSharedData()->network_outputs_[network_id] = std::static_pointer_cast<MuZeroNetwork>(network)->recurrentInference();
         }
     }
 }
@@ -137,21 +166,42 @@ void ActorGroup::run()
         handleCommand();
 
         if (!running_) { continue; }
-        getSharedData()->actor_index_ = 0;
+        scheduleCohorts();
+        getSharedData()->cpu_phase_time_ = getSharedData()->gpu_phase_time_ = 0;
+        getSharedData()->round_start_time_ = TimeSystem::getLocalTime();
         for (auto& t : slave_threads_) { t->start(); }
         for (auto& t : slave_threads_) { t->finish(); }
-        getSharedData()->do_cpu_job_ = !getSharedData()->do_cpu_job_;
+        updateCohorts();
+        reportPhaseTime();
     }
 }
 
 void ActorGroup::initialize()
 {
+    assert(config::zero_actor_num_cohorts > 0 && config::zero_actor_num_cohorts <= config::zero_num_parallel_games);
     int num_threads = std::max(static_cast<int>(torch::cuda::device_count()), config::zero_num_threads);
     createSlaveThreads(num_threads);
+    getSharedData()->cohort_wait_forward_.assign(config::zero_actor_num_cohorts, false);
+    getSharedData()->cpu_cohort_ = getSharedData()->gpu_cohort_ = -1;
     createNeuralNetworks();
     createActors();
     running_ = false;
-    getSharedData()->do_cpu_job_ = true;
+    last_cpu_cohort_ = -1;
+    num_reported_game_output_bytes_ = 0;
+    num_rounds_ = 0;
+    total_round_time_ = total_cpu_phase_time_ = total_gpu_phase_time_ = 0;
+    report_time_ = TimeSystem::getLocalTime();
+
+    // create one thread to write games, the compressed games are framed as "SelfPlayGzip <hex string of the gzip binary>" in the text protocol
+    if (config::zero_actor_binary_protocol) {
+        const bool compress = config::zero_actor_compress_game_output;
+        getSharedData()->game_writer_.start(
+            std::cout, [compress](const std::string& payload) { return utils::toWireFrame(compress ? utils::compressWireSelfPlayPayload(payload) : payload); }, "");
+    } else if (config::zero_actor_compress_game_output) {
+        getSharedData()->game_writer_.start(std::cout, [](const std::string& game) { return "SelfPlayGzip " + utils::compressString(game); });
+    } else {
+        getSharedData()->game_writer_.start(std::cout);
+    }
 
     // create one thread to handle I/O
     commands_.clear();
@@ -164,12 +214,17 @@ void ActorGroup::initialize()
 
 void ActorGroup::createNeuralNetworks()
 {
-    int num_networks = std::min(static_cast<int>(torch::cuda::device_count()), config::zero_num_parallel_games);
-    assert(num_networks > 0);
-    getSharedData()->networks_.resize(num_networks);
-    getSharedData()->network_outputs_.resize(num_networks);
-    for (int gpu_id = 0; gpu_id < num_networks; ++gpu_id) {
-        getSharedData()->networks_[gpu_id] = createNetwork(config::nn_file_name, gpu_id);
+    // each cohort has one network per GPU, or a single network on CPU for CPU-only builds
+    int num_gpus = torch::cuda::device_count();
+    int num_cohorts = getSharedData()->getNumCohorts();
+    int num_networks_per_cohort = (num_gpus > 0 ? std::min(num_gpus, config::zero_num_parallel_games / num_cohorts) : 1);
+    assert(num_networks_per_cohort > 0);
+    getSharedData()->networks_.resize(num_cohorts * num_networks_per_cohort);
+    getSharedData()->network_outputs_.resize(num_cohorts * num_networks_per_cohort);
+    for (int cohort = 0; cohort < num_cohorts; ++cohort) {
+        for (int gpu_id = 0; gpu_id < num_networks_per_cohort; ++gpu_id) {
+            getSharedData()->networks_[cohort * num_networks_per_cohort + gpu_id] = createNetwork(config::nn_file_name, (num_gpus > 0 ? gpu_id : -1));
+        }
     }
 }
 
@@ -179,8 +234,73 @@ void ActorGroup::createActors()
     std::shared_ptr<Network>& network = getSharedData()->networks_[0];
     uint64_t tree_node_size = static_cast<uint64_t>(config::actor_num_simulation + 1) * network->getActionSize();
     for (int i = 0; i < config::zero_num_parallel_games; ++i) {
-        getSharedData()->actors_.emplace_back(createActor(tree_node_size, getSharedData()->networks_[i % getSharedData()->networks_.size()]));
+        getSharedData()->actors_.emplace_back(createActor(tree_node_size, getSharedData()->networks_[getSharedData()->getNetworkIndex(i)]));
+    }
+}
+
+void ActorGroup::scheduleCohorts()
+{
+    // in each round, the cohort waiting for the network forward is forwarded while the next cohort in order does its CPU jobs,
+    // e.g., with two cohorts, the actors of one cohort select and expand nodes while the networks evaluate the leaves of the other;
+    // with a single cohort, the rounds alternate between CPU jobs and network forwards as before
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    const int num_cohorts = shared_data->getNumCohorts();
+    int gpu_cohort = -1;
+    for (int cohort = 0; cohort < num_cohorts && gpu_cohort == -1; ++cohort) {
+        if (shared_data->cohort_wait_forward_[cohort]) { gpu_cohort = cohort; }
+    }
+    int cpu_cohort = -1;
+    for (int i = 1; i <= num_cohorts && cpu_cohort == -1; ++i) {
+        int cohort = (last_cpu_cohort_ + i) % num_cohorts;
+        if (!shared_data->cohort_wait_forward_[cohort]) { cpu_cohort = cohort; }
     }
+
+    // drain the pending forwards before handling commands, since networks cannot be reloaded with pending inputs
+    if (!commands_.empty() && gpu_cohort != -1) { cpu_cohort = -1; }
+    shared_data->gpu_cohort_ = gpu_cohort;
+    shared_data->cpu_cohort_ = cpu_cohort;
+    if (cpu_cohort != -1) {
+        // several chunks per thread keep the threads balanced when some actors take longer, e.g., when their searches are done
+        const int num_chunks_per_thread = 4;
+        int num_cohort_actors = (shared_data->actors_.size() - cpu_cohort + num_cohorts - 1) / num_cohorts;
+        int chunk_size = std::max(1, num_cohort_actors / (static_cast<int>(slave_threads_.size()) * num_chunks_per_thread));
+        shared_data->actor_dispenser_.reset(num_cohort_actors, chunk_size);
+        last_cpu_cohort_ = cpu_cohort;
+    }
+}
+
+void ActorGroup::updateCohorts()
+{
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    if (shared_data->gpu_cohort_ != -1) { shared_data->cohort_wait_forward_[shared_data->gpu_cohort_] = false; }
+    if (shared_data->cpu_cohort_ != -1) { shared_data->cohort_wait_forward_[shared_data->cpu_cohort_] = true; }
+}
+
+void ActorGroup::reportPhaseTime()
+{
+    std::shared_ptr<ThreadSharedData> shared_data = getSharedData();
+    ++num_rounds_;
+    total_round_time_ += (TimeSystem::getLocalTime() - shared_data->round_start_time_).total_microseconds();
+    total_cpu_phase_time_ += shared_data->cpu_phase_time_;
+    total_gpu_phase_time_ += shared_data->gpu_phase_time_;
+
+    const int report_period_seconds = 60;
+    double elapsed_seconds = (TimeSystem::getLocalTime() - report_time_).total_milliseconds() / 1000.0;
+    if (elapsed_seconds < report_period_seconds) { return; }
+    uint64_t num_game_output_bytes = shared_data->game_writer_.getNumWrittenBytes();
+    std::cerr << TimeSystem::getTimeString("[Y/m/d H:i:s.f] ")
+              << "cohorts: " << shared_data->getNumCohorts()
+              << ", rounds: " << num_rounds_
+              << ", round time: " << total_round_time_ / num_rounds_ / 1000 << " ms"
+              << ", cpu phase: " << total_cpu_phase_time_ / num_rounds_ / 1000 << " ms"
+              << ", gpu phase: " << total_gpu_phase_time_ / num_rounds_ / 1000 << " ms"
+              << ", gpu busy: " << 100 * total_gpu_phase_time_ / total_round_time_ << "%"
+              << ", game output queue: " << shared_data->game_writer_.getQueueSize()
+              << ", game output: " << (num_game_output_bytes - num_reported_game_output_bytes_) / 1024.0 / elapsed_seconds << " KB/s" << std::endl;
+    num_reported_game_output_bytes_ = num_game_output_bytes;
+    num_rounds_ = 0;
+    total_round_time_ = total_cpu_phase_time_ = total_gpu_phase_time_ = 0;
+    report_time_ = TimeSystem::getLocalTime();
 }
 
 void ActorGroup::handleIO()
@@ -196,7 +316,7 @@ void ActorGroup::handleIO()
 
 void ActorGroup::handleCommand()
 {
-    if (commands_.empty() || !getSharedData()->do_cpu_job_) { return; }
+    if (commands_.empty() || getSharedData()->hasPendingForward()) { return; }
 
     std::lock_guard lock(getSharedData()->mutex_);
     while (!commands_.empty()) {
@@ -220,7 +340,6 @@ void ActorGroup::handleCommand(const std::string& command_prefix, const std::str
     if (command_prefix == "reset_actors") {
         std::cerr << "[command] " << command << std::endl;
         for (auto& actor : getSharedData()->actors_) { actor->reset(); }
-        getSharedData()->do_cpu_job_ = true;
     } else if (command_prefix == "load_model") {
         std::cerr << "[command] " << command << std::endl;
         std::vector<std::string> args = utils::stringToVector(command);
@@ -244,6 +363,7 @@ void ActorGroup::handleCommand(const std::string& command_prefix, const std::str
         running_ = false;
     } else if (command_prefix == "quit") {
         std::cerr << "[command] " << command << std::endl;
+        getSharedData()->game_writer_.stop(); // write all pending games before exiting
         exit(0);
     }
 }
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "async_writer.h"
 #include "base_actor.h"
 #include "network.h"
 #include "paralleler.h"
+#include "time_system.h"
+#include <algorithm>
 #include <deque>
 #include <memory>
 #include <mutex>
@@ -15,13 +18,26 @@ namespace minizero::actor {
 
 class ThreadSharedData : public utils::BaseSharedData {
 public:
-    int getAvailableActorIndex();
     void outputGame(const std::shared_ptr<BaseActor>& actor);
     std::pair<int, int> calculateTrainingDataRange(const std::shared_ptr<BaseActor>& actor);
+    void updatePhaseTime(double& phase_time);
+
+    // actors are interleaved into cohorts, and each cohort has its own networks
+    inline int getNumCohorts() const { return cohort_wait_forward_.size(); }
+    inline int getNumNetworksPerCohort() const { return networks_.size() / getNumCohorts(); }
+    inline int getCohortIndex(int actor_id) const { return actor_id % getNumCohorts(); }
+    inline int getNetworkIndex(int actor_id) const { return getCohortIndex(actor_id) * getNumNetworksPerCohort() + (actor_id / getNumCohorts()) % getNumNetworksPerCohort(); }
+    inline bool hasPendingForward() const { return std::find(cohort_wait_forward_.begin(), cohort_wait_forward_.end(), true) != cohort_wait_forward_.end(); }
 
-    bool do_cpu_job_;
-    int actor_index_;
+    utils::IndexDispenser actor_dispenser_; // dispenses the actors of cpu_cohort_, i.e., the k-th index is actor cpu_cohort_ + k * getNumCohorts()
+    int cpu_cohort_;                        // the cohort whose actors do CPU jobs in this round, -1 for none
+    int gpu_cohort_;                        // the cohort whose networks forward in this round, -1 for none
+    std::vector<bool> cohort_wait_forward_; // whether the actors of a cohort have pushed their inputs and wait for the network forward
+    boost::posix_time::ptime round_start_time_;
+    double cpu_phase_time_; // the elapsed microseconds until all CPU jobs in this round are done
+    double gpu_phase_time_; // the elapsed microseconds until all network forwards in this round are done
     std::mutex mutex_;
+    utils::AsyncWriter game_writer_;
     std::vector<std::shared_ptr<BaseActor>> actors_;
     std::vector<std::shared_ptr<network::Network>> networks_;
     std::vector<std::vector<std::shared_ptr<network::NetworkOutput>>> network_outputs_;
@@ -37,10 +53,13 @@ public:
     bool isDone() override { return false; }
 
 protected:
+    int getAvailableActorIndex();
     virtual bool doCPUJob();
     virtual void doGPUJob();
     virtual void handleSearchDone(int actor_id);
     inline std::shared_ptr<ThreadSharedData> getSharedData() { return std::static_pointer_cast<ThreadSharedData>(shared_data_); }
+
+    std::pair<int, int> actor_chunk_; // the range of actor indices taken from the dispenser but not done yet
 };
 
 class ActorGroup : public utils::BaseParalleler {
@@ -54,6 +73,9 @@ public:
 protected:
     virtual void createNeuralNetworks();
     virtual void createActors();
+    virtual void scheduleCohorts();
+    virtual void updateCohorts();
+    virtual void reportPhaseTime();
     virtual void handleIO();
     virtual void handleCommand();
     virtual void handleCommand(const std::string& command_prefix, const std::string& command);
@@ -63,6 +85,13 @@ protected:
     inline std::shared_ptr<ThreadSharedData> getSharedData() { return std::static_pointer_cast<ThreadSharedData>(shared_data_); }
 
     bool running_;
+    int last_cpu_cohort_;
+    int num_rounds_;
+    double total_round_time_;
+    double total_cpu_phase_time_;
+    double total_gpu_phase_time_;
+    uint64_t num_reported_game_output_bytes_;
+    boost::posix_time::ptime report_time_;
     std::deque<std::string> commands_;
     std::unordered_set<std::string> ignored_commands_;
 };
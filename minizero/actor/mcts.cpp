@@ -6,40 +6,40 @@ void MCTSNode::reset()
 {
     num_children_ = 0;
     hidden_state_data_index_ = -1;
-    mean_ = 0.0f;
-    count_ = 0.0f;
-    virtual_loss_ = 0.0f;
-    policy_ = 0.0f;
+    mean() = 0.0f;
+    count() = 0.0f;
+    virtualLoss() = 0.0f;
+    policy() = 0.0f;
     policy_logit_ = 0.0f;
     policy_noise_ = 0.0f;
     value_ = 0.0f;
-    reward_ = 0.0f;
+    reward() = 0.0f;
     first_child_ = nullptr;
 }
 
 void MCTSNode::add(float value, float weight /* = 1.0f */)
 {
-    if (count_ + weight <= 0) {
+    if (count() + weight <= 0) {
         reset();
     } else {
-        count_ += weight;
-        mean_ += weight * (value - mean_) / count_;
+        count() += weight;
+        mean() += weight * (value - mean()) / count();
     }
 }
 
 void MCTSNode::remove(float value, float weight /* = 1.0f */)
 {
-    if (count_ - weight <= 0) {
+    if (count() - weight <= 0) {
         reset();
     } else {
-        count_ -= weight;
-        mean_ -= weight * (value - mean_) / count_;
+        count() -= weight;
+        mean() -= weight * (value - mean()) / count();
     }
 }
 
 float MCTSNode::getNormalizedMean(const std::map<float, int>& tree_value_bound) const
 {
-    float value = reward_ + config::actor_mcts_reward_discount * mean_;
+    float value = reward() + config::actor_mcts_reward_discount * mean();
     if (config::actor_mcts_value_rescale) {
         if (tree_value_bound.size() < 2) { return 1.0f; }
         const float value_lower_bound = tree_value_bound.begin()->first;
@@ -48,7 +48,8 @@ float MCTSNode::getNormalizedMean(const std::map<float, int>& tree_value_bound)
         value = fmin(1, fmax(-1, 2 * value - 1)); // normalize to [-1, 1]
     }
     value = (action_.getPlayer() == env::charToPlayer(config::actor_mcts_value_flipping_player) ? -value : value); // flip value according to player
-    value = (value * count_ - virtual_loss_) / getCountWithVirtualLoss();    // value with virtual loss
+    const float virtual_loss = virtualLoss();
+    value = (value * count() - virtual_loss) / (count() + virtual_loss); // value with virtual loss
     return value;
 }
 
@@ -60,17 +61,33 @@ float MCTSNode::getNormalizedPUCTScore(int total_simulation, const std::map<floa
     return value_u + value_q;
 }
 
+void MCTSNode::copyFrom(const MCTSNode& node)
+{
+    action_ = node.action_;
+    num_children_ = node.num_children_;
+    first_child_ = node.first_child_;
+    hidden_state_data_index_ = node.hidden_state_data_index_;
+    mean() = node.mean();
+    count() = node.count();
+    virtualLoss() = node.virtualLoss();
+    policy() = node.policy();
+    policy_logit_ = node.policy_logit_;
+    policy_noise_ = node.policy_noise_;
+    value_ = node.value_;
+    reward() = node.reward();
+}
+
 std::string MCTSNode::toString() const
 {
     std::ostringstream oss;
     oss.precision(4);
-    oss << std::fixed << "p = " << policy_
+    oss << std::fixed << "p = " << policy()
         << ", p_logit = " << policy_logit_
         << ", p_noise = " << policy_noise_
         << ", v = " << value_
-        << ", r = " << reward_
-        << ", mean = " << mean_
-        << ", count = " << count_;
+        << ", r = " << reward()
+        << ", mean = " << mean()
+        << ", count = " << count();
     return oss.str();
 }
 
@@ -178,9 +195,71 @@ void MCTS::backup(const std::vector<MCTSNode*>& node_path, const float value, co
     }
 }
 
+void MCTS::reuseSubtree(MCTSNode* node)
+{
+    assert(node && node != getRootNode());
+
+    // collect the children blocks in the subtree, sorted by their positions in the node pool
+    std::vector<MCTSNode*> blocks;
+    std::vector<MCTSNode*> stack{node};
+    while (!stack.empty()) {
+        MCTSNode* current = stack.back();
+        stack.pop_back();
+        if (current->isLeaf()) { continue; }
+        blocks.push_back(current->getChild(0));
+        for (int i = 0; i < current->getNumChildren(); ++i) { stack.push_back(current->getChild(i)); }
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    // compact the subtree to the front of the node pool
+    // a block is always allocated after the block of its parent, so moving blocks in order never overwrites a block that has not been moved yet
+    std::unordered_map<MCTSNode*, MCTSNode*> block_parent; // original first child -> relocated parent
+    MCTSNode* root = getRootNode();
+    root->copyFrom(*node);
+    if (!root->isLeaf()) { block_parent[root->getChild(0)] = root; }
+    uint64_t node_size = 1;
+    for (MCTSNode* block : blocks) {
+        MCTSNode* parent = block_parent[block];
+        MCTSNode* relocated = root + node_size;
+        for (int i = 0; i < parent->getNumChildren(); ++i) {
+            if (relocated != block) { relocated[i].copyFrom(block[i]); }
+            if (!relocated[i].isLeaf()) { block_parent[relocated[i].getChild(0)] = &relocated[i]; }
+        }
+        parent->setFirstChild(relocated);
+        node_size += parent->getNumChildren();
+    }
+    current_node_size_ = node_size;
+
+    // remap the hidden states and rebuild the tree value bound for the remaining nodes
+    std::vector<int> hidden_state_data_indices;
+    tree_value_bound_.clear();
+    for (uint64_t i = 0; i < node_size; ++i) {
+        MCTSNode* current = root + i;
+        if (current->getHiddenStateDataIndex() != -1) {
+            hidden_state_data_indices.push_back(current->getHiddenStateDataIndex());
+            current->setHiddenStateDataIndex(hidden_state_data_indices.size() - 1);
+        }
+        if (config::actor_mcts_value_rescale && current->getCount() > 0) { ++tree_value_bound_[current->getReward() + config::actor_mcts_reward_discount * current->getMean()]; }
+    }
+    tree_hidden_state_data_.keep(hidden_state_data_indices);
+}
+
+TreeNode* MCTS::createTreeNodes(uint64_t tree_node_size)
+{
+    MCTSNode* nodes = new MCTSNode[tree_node_size];
+#if MCTS_SOA
+    statistics_.resize(tree_node_size);
+    for (uint64_t i = 0; i < tree_node_size; ++i) { nodes[i].bindStatistics(&statistics_, i); }
+#endif
+    return nodes;
+}
+
 MCTSNode* MCTS::selectChildByPUCTScore(const MCTSNode* node) const
 {
     assert(node && !node->isLeaf());
+#if MCTS_SOA
+    MCTSNode* selected = node->getChild(selectPUCTChildIndex(getPUCTKernelInput(node), calculateInitQValue(node)));
+#else
     MCTSNode* selected = nullptr;
     int total_simulation = node->getCountWithVirtualLoss() - 1;
     float init_q_value = calculateInitQValue(node);
@@ -193,6 +272,7 @@ MCTSNode* MCTS::selectChildByPUCTScore(const MCTSNode* node) const
         best_policy = child->getPolicy();
         selected = child;
     }
+#endif
     assert(selected != nullptr);
     return selected;
 }
@@ -202,12 +282,16 @@ float MCTS::calculateInitQValue(const MCTSNode* node) const
     // init Q value = avg Q value of all visited children + one loss
     assert(node && !node->isLeaf());
     float sum_of_win = 0.0f, sum = 0.0f;
+#if MCTS_SOA
+    sumPUCTVisitedNormalizedMean(getPUCTKernelInput(node), sum_of_win, sum);
+#else
     for (int i = 0; i < node->getNumChildren(); ++i) {
         MCTSNode* child = node->getChild(i);
         if (child->getCountWithVirtualLoss() == 0) { continue; }
         sum_of_win += child->getNormalizedMean(tree_value_bound_);
         sum += 1;
     }
+#endif
 #if ATARI
     // explore more in Atari games (TODO: check if this method also performs better in board games)
     return (sum > 0 ? sum_of_win / sum : 1.0f);
@@ -216,6 +300,32 @@ float MCTS::calculateInitQValue(const MCTSNode* node) const
 #endif
 }
 
+#if MCTS_SOA
+PUCTKernelInput MCTS::getPUCTKernelInput(const MCTSNode* node) const
+{
+    assert(node && !node->isLeaf());
+    const int first_child_index = node->getChild(0)->getStatisticsIndex();
+    const int total_simulation = node->getCountWithVirtualLoss() - 1;
+
+    PUCTKernelInput input;
+    input.size_ = node->getNumChildren();
+    input.count_ = statistics_.count_.data() + first_child_index;
+    input.mean_ = statistics_.mean_.data() + first_child_index;
+    input.virtual_loss_ = statistics_.virtual_loss_.data() + first_child_index;
+    input.policy_ = statistics_.policy_.data() + first_child_index;
+    input.reward_ = statistics_.reward_.data() + first_child_index;
+    input.reward_discount_ = config::actor_mcts_reward_discount;
+    input.value_sign_ = (node->getChild(0)->getAction().getPlayer() == env::charToPlayer(config::actor_mcts_value_flipping_player) ? -1.0f : 1.0f); // all children share the same player
+    input.value_rescale_ = config::actor_mcts_value_rescale;
+    input.value_bound_is_empty_ = (tree_value_bound_.size() < 2);
+    input.value_lower_bound_ = (input.value_bound_is_empty_ ? 0.0f : tree_value_bound_.begin()->first);
+    input.value_upper_bound_ = (input.value_bound_is_empty_ ? 0.0f : tree_value_bound_.rbegin()->first);
+    input.puct_bias_ = config::actor_mcts_puct_init + log((1 + total_simulation + config::actor_mcts_puct_base) / config::actor_mcts_puct_base);
+    input.sqrt_total_simulation_ = sqrt(total_simulation);
+    return input;
+}
+#endif
+
 void MCTS::updateTreeValueBound(float old_value, float new_value)
 {
     if (!config::actor_mcts_value_rescale) { return; }
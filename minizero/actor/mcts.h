@@ -2,66 +2,137 @@
 
 #include "configuration.h"
 #include "environment.h"
+#include "mcts_kernel.h"
 #include "random.h"
 #include "search.h"
 #include "tree.h"
 #include <algorithm>
+#include <boost/atomic/atomic_ref.hpp>
 #include <cmath>
 #include <limits>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace minizero::actor {
 
+#if MCTS_SOA
+class MCTSNodeStatistics {
+public:
+    inline void resize(uint64_t size)
+    {
+        count_.resize(size, 0.0f);
+        mean_.resize(size, 0.0f);
+        virtual_loss_.resize(size, 0.0f);
+        policy_.resize(size, 0.0f);
+        reward_.resize(size, 0.0f);
+    }
+
+    // the statistics of siblings are contiguous since children are allocated as a block
+    std::vector<float> count_;
+    std::vector<float> mean_;
+    std::vector<float> virtual_loss_;
+    std::vector<float> policy_;
+    std::vector<float> reward_;
+};
+#endif
+
 class MCTSNode : public TreeNode {
 public:
+#if MCTS_SOA
+    MCTSNode() : statistics_index_(-1), statistics_(nullptr) {}
+#else
     MCTSNode() { reset(); }
+#endif
 
     void reset() override;
     virtual void add(float value, float weight = 1.0f);
     virtual void remove(float value, float weight = 1.0f);
     virtual float getNormalizedMean(const std::map<float, int>& tree_value_bound) const;
     virtual float getNormalizedPUCTScore(int total_simulation, const std::map<float, int>& tree_value_bound, float init_q_value = -1.0f) const;
+    virtual void copyFrom(const MCTSNode& node);
     std::string toString() const override;
-    bool displayInTreeLog() const override { return count_ > 0; }
+    bool displayInTreeLog() const override { return count() > 0; }
 
     // setter
     inline void setHiddenStateDataIndex(int hidden_state_data_index) { hidden_state_data_index_ = hidden_state_data_index; }
-    inline void setMean(float mean) { mean_ = mean; }
-    inline void setCount(float count) { count_ = count; }
-    inline void addVirtualLoss(float num = 1.0f) { virtual_loss_ += num; }
-    inline void removeVirtualLoss(float num = 1.0f) { virtual_loss_ -= num; }
-    inline void setPolicy(float policy) { policy_ = policy; }
+    inline void setMean(float mean) { this->mean() = mean; }
+    inline void setCount(float count) { this->count() = count; }
+    inline void addVirtualLoss(float num = 1.0f) { virtualLoss() += num; }
+    inline void removeVirtualLoss(float num = 1.0f) { virtualLoss() -= num; }
+    inline float addVirtualLossAtomically(float num = 1.0f) { return boost::atomic_ref<float>(virtualLoss()).fetch_add(num); } // return the virtual loss before adding
+    inline void removeVirtualLossAtomically(float num = 1.0f) { boost::atomic_ref<float>(virtualLoss()).fetch_sub(num); }
+    inline void setPolicy(float policy) { this->policy() = policy; }
     inline void setPolicyLogit(float policy_logit) { policy_logit_ = policy_logit; }
     inline void setPolicyNoise(float policy_noise) { policy_noise_ = policy_noise; }
     inline void setValue(float value) { value_ = value; }
-    inline void setReward(float reward) { reward_ = reward; }
+    inline void setReward(float reward) { this->reward() = reward; }
     inline void setFirstChild(MCTSNode* first_child) { TreeNode::setFirstChild(first_child); }
 
     // getter
     inline int getHiddenStateDataIndex() const { return hidden_state_data_index_; }
-    inline float getMean() const { return mean_; }
-    inline float getCount() const { return count_; }
-    inline float getCountWithVirtualLoss() const { return count_ + virtual_loss_; }
-    inline float getVirtualLoss() const { return virtual_loss_; }
-    inline float getPolicy() const { return policy_; }
+    inline float getMean() const { return mean(); }
+    inline float getCount() const { return count(); }
+    inline float getCountWithVirtualLoss() const { return count() + virtualLoss(); }
+    inline float getVirtualLoss() const { return virtualLoss(); }
+    inline float getPolicy() const { return policy(); }
     inline float getPolicyLogit() const { return policy_logit_; }
     inline float getPolicyNoise() const { return policy_noise_; }
     inline float getValue() const { return value_; }
-    inline float getReward() const { return reward_; }
+    inline float getReward() const { return reward(); }
     inline virtual MCTSNode* getChild(int index) const override { return (index < num_children_ ? static_cast<MCTSNode*>(first_child_) + index : nullptr); }
 
+#if MCTS_SOA
+    inline void bindStatistics(MCTSNodeStatistics* statistics, int statistics_index)
+    {
+        statistics_ = statistics;
+        statistics_index_ = statistics_index;
+        reset();
+    }
+    inline int getStatisticsIndex() const { return statistics_index_; }
+#endif
+
 protected:
+    // virtual losses are modified atomically by other threads during tree-parallel selection, so they are also read atomically (relaxed loads cost nothing on x86)
+#if MCTS_SOA
+    inline float& mean() { return statistics_->mean_[statistics_index_]; }
+    inline float& count() { return statistics_->count_[statistics_index_]; }
+    inline float& virtualLoss() { return statistics_->virtual_loss_[statistics_index_]; }
+    inline float& policy() { return statistics_->policy_[statistics_index_]; }
+    inline float& reward() { return statistics_->reward_[statistics_index_]; }
+    inline float mean() const { return statistics_->mean_[statistics_index_]; }
+    inline float count() const { return statistics_->count_[statistics_index_]; }
+    inline float virtualLoss() const { return boost::atomic_ref<float>(statistics_->virtual_loss_[statistics_index_]).load(boost::memory_order_relaxed); }
+    inline float policy() const { return statistics_->policy_[statistics_index_]; }
+    inline float reward() const { return statistics_->reward_[statistics_index_]; }
+#else
+    inline float& mean() { return mean_; }
+    inline float& count() { return count_; }
+    inline float& virtualLoss() { return virtual_loss_; }
+    inline float& policy() { return policy_; }
+    inline float& reward() { return reward_; }
+    inline float mean() const { return mean_; }
+    inline float count() const { return count_; }
+    inline float virtualLoss() const { return boost::atomic_ref<float>(const_cast<float&>(virtual_loss_)).load(boost::memory_order_relaxed); }
+    inline float policy() const { return policy_; }
+    inline float reward() const { return reward_; }
+#endif
+
     int hidden_state_data_index_;
+    float policy_logit_;
+    float policy_noise_;
+    float value_;
+#if MCTS_SOA
+    int statistics_index_;
+    MCTSNodeStatistics* statistics_;
+#else
     float mean_;
     float count_;
     float virtual_loss_;
     float policy_;
-    float policy_logit_;
-    float policy_noise_;
-    float value_;
     float reward_;
+#endif
 };
 
 class HiddenStateData {
@@ -95,10 +166,11 @@ public:
     virtual std::vector<MCTSNode*> selectFromNode(MCTSNode* start_node);
     virtual void expand(MCTSNode* leaf_node, const std::vector<ActionCandidate>& action_candidates);
     virtual void backup(const std::vector<MCTSNode*>& node_path, const float value, const float reward = 0.0f);
+    virtual void reuseSubtree(MCTSNode* node);
 
     inline MCTSNode* allocateNodes(int size) { return static_cast<MCTSNode*>(Tree::allocateNodes(size)); }
     inline int getNumSimulation() const { return getRootNode()->getCount(); }
-    inline bool reachMaximumSimulation() const { return (getNumSimulation() == config::actor_num_simulation + 1); }
+    inline bool reachMaximumSimulation() const { return (getNumSimulation() >= config::actor_num_simulation + 1); }
     inline MCTSNode* getRootNode() { return static_cast<MCTSNode*>(Tree::getRootNode()); }
     inline const MCTSNode* getRootNode() const { return static_cast<const MCTSNode*>(Tree::getRootNode()); }
     inline TreeHiddenStateData& getTreeHiddenStateData() { return tree_hidden_state_data_; }
@@ -107,12 +179,17 @@ public:
     inline const std::map<float, int>& getTreeValueBound() const { return tree_value_bound_; }
 
 protected:
-    TreeNode* createTreeNodes(uint64_t tree_node_size) override { return new MCTSNode[tree_node_size]; }
+    TreeNode* createTreeNodes(uint64_t tree_node_size) override;
     TreeNode* getNodeIndex(int index) override { return getRootNode() + index; }
 
     virtual MCTSNode* selectChildByPUCTScore(const MCTSNode* node) const;
     virtual float calculateInitQValue(const MCTSNode* node) const;
     virtual void updateTreeValueBound(float old_value, float new_value);
+#if MCTS_SOA
+    PUCTKernelInput getPUCTKernelInput(const MCTSNode* node) const;
+
+    MCTSNodeStatistics statistics_;
+#endif
 
     std::map<float, int> tree_value_bound_;
     TreeHiddenStateData tree_hidden_state_data_;
@@ -0,0 +1,273 @@
+#include "mcts_kernel.h"
+#include <algorithm>
+#include <boost/atomic/atomic_ref.hpp>
+#include <limits>
+#include <string>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace minizero::actor {
+
+// virtual losses may be added by other threads during tree-parallel selection, so the scalar path reads them by relaxed atomic loads
+inline float loadVirtualLoss(const PUCTKernelInput& input, int index)
+{
+    return boost::atomic_ref<float>(const_cast<float&>(input.virtual_loss_[index])).load(boost::memory_order_relaxed);
+}
+
+inline float calculateNormalizedMean(const PUCTKernelInput& input, int index, float virtual_loss)
+{
+    if (input.value_rescale_ && input.value_bound_is_empty_) { return 1.0f; }
+    float value = input.reward_[index] + input.reward_discount_ * input.mean_[index];
+    if (input.value_rescale_) {
+        value = (value - input.value_lower_bound_) / (input.value_upper_bound_ - input.value_lower_bound_);
+        value = std::min(1.0f, std::max(-1.0f, 2 * value - 1)); // normalize to [-1, 1]
+    }
+    value = input.value_sign_ * value;
+    return (value * input.count_[index] - virtual_loss) / (input.count_[index] + virtual_loss);
+}
+
+inline float calculatePUCTScore(const PUCTKernelInput& input, int index, float init_q_value)
+{
+    const float virtual_loss = loadVirtualLoss(input, index);
+    const float count_with_virtual_loss = input.count_[index] + virtual_loss;
+    float value_u = (input.puct_bias_ * input.policy_[index] * input.sqrt_total_simulation_) / (1 + count_with_virtual_loss);
+    float value_q = (count_with_virtual_loss == 0 ? init_q_value : calculateNormalizedMean(input, index, virtual_loss));
+    return value_u + value_q;
+}
+
+// keep the first (score, policy) maximum in index order
+inline bool isBetterPUCTCandidate(float score, float policy, int index, float best_score, float best_policy, int best_index)
+{
+    if (best_index == -1 || score > best_score) { return true; }
+    if (score < best_score) { return false; }
+    return (policy > best_policy || (policy == best_policy && index < best_index));
+}
+
+// the vector kernels load virtual losses with plain vector loads, which may overlap fetch_add of other threads during tree-parallel selection:
+// each float lane is naturally aligned, so x86 never tears a lane and a lane only reads either the old or the new virtual loss,
+// and reading the old one is the same as the other thread adding its virtual loss just after the load, which selection already tolerates
+#if defined(__AVX512F__)
+
+inline __m512 calculateNormalizedMean(const PUCTKernelInput& input, __m512 count, __m512 mean, __m512 virtual_loss, __m512 reward, __m512 count_with_virtual_loss)
+{
+    if (input.value_rescale_ && input.value_bound_is_empty_) { return _mm512_set1_ps(1.0f); }
+    __m512 value = _mm512_add_ps(reward, _mm512_mul_ps(_mm512_set1_ps(input.reward_discount_), mean));
+    if (input.value_rescale_) {
+        const __m512 one = _mm512_set1_ps(1.0f);
+        value = _mm512_div_ps(_mm512_sub_ps(value, _mm512_set1_ps(input.value_lower_bound_)), _mm512_set1_ps(input.value_upper_bound_ - input.value_lower_bound_));
+        value = _mm512_sub_ps(_mm512_mul_ps(_mm512_set1_ps(2.0f), value), one);
+        value = _mm512_min_ps(one, _mm512_max_ps(_mm512_set1_ps(-1.0f), value));
+    }
+    value = _mm512_mul_ps(_mm512_set1_ps(input.value_sign_), value);
+    return _mm512_div_ps(_mm512_sub_ps(_mm512_mul_ps(value, count), virtual_loss), count_with_virtual_loss);
+}
+
+void sumPUCTVisitedNormalizedMean(const PUCTKernelInput& input, float& sum_of_mean, float& num_visited)
+{
+    __m512 sum = _mm512_setzero_ps(), num = _mm512_setzero_ps();
+    for (int i = 0; i < input.size_; i += 16) {
+        const __mmask16 tail_mask = (input.size_ - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (input.size_ - i)) - 1));
+        __m512 count = _mm512_maskz_loadu_ps(tail_mask, input.count_ + i);
+        __m512 mean = _mm512_maskz_loadu_ps(tail_mask, input.mean_ + i);
+        __m512 virtual_loss = _mm512_maskz_loadu_ps(tail_mask, input.virtual_loss_ + i);
+        __m512 reward = _mm512_maskz_loadu_ps(tail_mask, input.reward_ + i);
+        __m512 count_with_virtual_loss = _mm512_add_ps(count, virtual_loss);
+        __mmask16 visited = _mm512_mask_cmp_ps_mask(tail_mask, count_with_virtual_loss, _mm512_setzero_ps(), _CMP_NEQ_OQ);
+        __m512 normalized_mean = calculateNormalizedMean(input, count, mean, virtual_loss, reward, count_with_virtual_loss);
+        sum = _mm512_mask_add_ps(sum, visited, sum, normalized_mean);
+        num = _mm512_mask_add_ps(num, visited, num, _mm512_set1_ps(1.0f));
+    }
+    sum_of_mean = _mm512_reduce_add_ps(sum);
+    num_visited = _mm512_reduce_add_ps(num);
+}
+
+int selectPUCTChildIndex(const PUCTKernelInput& input, float init_q_value)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 puct_factor = _mm512_set1_ps(input.puct_bias_);
+    const __m512 sqrt_total_simulation = _mm512_set1_ps(input.sqrt_total_simulation_);
+    const __m512 init_q = _mm512_set1_ps(init_q_value);
+    __m512 best_score = _mm512_set1_ps(std::numeric_limits<float>::lowest());
+    __m512 best_policy = _mm512_set1_ps(std::numeric_limits<float>::lowest());
+    __m512i best_index = _mm512_set1_epi32(-1);
+    __m512i index = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    for (int i = 0; i < input.size_; i += 16) {
+        const __mmask16 tail_mask = (input.size_ - i >= 16 ? 0xFFFF : static_cast<__mmask16>((1u << (input.size_ - i)) - 1));
+        __m512 count = _mm512_maskz_loadu_ps(tail_mask, input.count_ + i);
+        __m512 mean = _mm512_maskz_loadu_ps(tail_mask, input.mean_ + i);
+        __m512 virtual_loss = _mm512_maskz_loadu_ps(tail_mask, input.virtual_loss_ + i);
+        __m512 policy = _mm512_maskz_loadu_ps(tail_mask, input.policy_ + i);
+        __m512 reward = _mm512_maskz_loadu_ps(tail_mask, input.reward_ + i);
+        __m512 count_with_virtual_loss = _mm512_add_ps(count, virtual_loss);
+
+        __m512 value_u = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(puct_factor, policy), sqrt_total_simulation), _mm512_add_ps(one, count_with_virtual_loss));
+        __m512 value_q = calculateNormalizedMean(input, count, mean, virtual_loss, reward, count_with_virtual_loss);
+        value_q = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(count_with_virtual_loss, _mm512_setzero_ps(), _CMP_EQ_OQ), value_q, init_q);
+        __m512 score = _mm512_add_ps(value_u, value_q);
+
+        __mmask16 better = _mm512_cmp_ps_mask(score, best_score, _CMP_GT_OQ) |
+                           (_mm512_cmp_ps_mask(score, best_score, _CMP_EQ_OQ) & _mm512_cmp_ps_mask(policy, best_policy, _CMP_GT_OQ));
+        better &= tail_mask;
+        best_score = _mm512_mask_blend_ps(better, best_score, score);
+        best_policy = _mm512_mask_blend_ps(better, best_policy, policy);
+        best_index = _mm512_mask_blend_epi32(better, best_index, index);
+        index = _mm512_add_epi32(index, _mm512_set1_epi32(16));
+    }
+
+    alignas(64) float lane_score[16], lane_policy[16];
+    alignas(64) int lane_index[16];
+    _mm512_store_ps(lane_score, best_score);
+    _mm512_store_ps(lane_policy, best_policy);
+    _mm512_store_si512(lane_index, best_index);
+    int selected = -1;
+    float selected_score = 0.0f, selected_policy = 0.0f;
+    for (int lane = 0; lane < 16; ++lane) {
+        if (lane_index[lane] == -1 || !isBetterPUCTCandidate(lane_score[lane], lane_policy[lane], lane_index[lane], selected_score, selected_policy, selected)) { continue; }
+        selected = lane_index[lane];
+        selected_score = lane_score[lane];
+        selected_policy = lane_policy[lane];
+    }
+    return selected;
+}
+
+std::string getPUCTKernelName() { return "avx512"; }
+
+#elif defined(__AVX2__)
+
+inline __m256 calculateNormalizedMean(const PUCTKernelInput& input, __m256 count, __m256 mean, __m256 virtual_loss, __m256 reward, __m256 count_with_virtual_loss)
+{
+    if (input.value_rescale_ && input.value_bound_is_empty_) { return _mm256_set1_ps(1.0f); }
+    __m256 value = _mm256_add_ps(reward, _mm256_mul_ps(_mm256_set1_ps(input.reward_discount_), mean));
+    if (input.value_rescale_) {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        value = _mm256_div_ps(_mm256_sub_ps(value, _mm256_set1_ps(input.value_lower_bound_)), _mm256_set1_ps(input.value_upper_bound_ - input.value_lower_bound_));
+        value = _mm256_sub_ps(_mm256_mul_ps(_mm256_set1_ps(2.0f), value), one);
+        value = _mm256_min_ps(one, _mm256_max_ps(_mm256_set1_ps(-1.0f), value));
+    }
+    value = _mm256_mul_ps(_mm256_set1_ps(input.value_sign_), value);
+    return _mm256_div_ps(_mm256_sub_ps(_mm256_mul_ps(value, count), virtual_loss), count_with_virtual_loss);
+}
+
+void sumPUCTVisitedNormalizedMean(const PUCTKernelInput& input, float& sum_of_mean, float& num_visited)
+{
+    const int vector_size = input.size_ - input.size_ % 8;
+    __m256 sum = _mm256_setzero_ps(), num = _mm256_setzero_ps();
+    for (int i = 0; i < vector_size; i += 8) {
+        __m256 count = _mm256_loadu_ps(input.count_ + i);
+        __m256 mean = _mm256_loadu_ps(input.mean_ + i);
+        __m256 virtual_loss = _mm256_loadu_ps(input.virtual_loss_ + i);
+        __m256 reward = _mm256_loadu_ps(input.reward_ + i);
+        __m256 count_with_virtual_loss = _mm256_add_ps(count, virtual_loss);
+        __m256 visited = _mm256_cmp_ps(count_with_virtual_loss, _mm256_setzero_ps(), _CMP_NEQ_OQ);
+        __m256 normalized_mean = calculateNormalizedMean(input, count, mean, virtual_loss, reward, count_with_virtual_loss);
+        sum = _mm256_add_ps(sum, _mm256_and_ps(visited, normalized_mean));
+        num = _mm256_add_ps(num, _mm256_and_ps(visited, _mm256_set1_ps(1.0f)));
+    }
+
+    alignas(32) float lane_sum[8], lane_num[8];
+    _mm256_store_ps(lane_sum, sum);
+    _mm256_store_ps(lane_num, num);
+    sum_of_mean = num_visited = 0.0f;
+    for (int lane = 0; lane < 8; ++lane) {
+        sum_of_mean += lane_sum[lane];
+        num_visited += lane_num[lane];
+    }
+    for (int i = vector_size; i < input.size_; ++i) {
+        const float virtual_loss = loadVirtualLoss(input, i);
+        if (input.count_[i] + virtual_loss == 0) { continue; }
+        sum_of_mean += calculateNormalizedMean(input, i, virtual_loss);
+        num_visited += 1;
+    }
+}
+
+int selectPUCTChildIndex(const PUCTKernelInput& input, float init_q_value)
+{
+    const int vector_size = input.size_ - input.size_ % 8;
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 puct_factor = _mm256_set1_ps(input.puct_bias_);
+    const __m256 sqrt_total_simulation = _mm256_set1_ps(input.sqrt_total_simulation_);
+    const __m256 init_q = _mm256_set1_ps(init_q_value);
+    __m256 best_score = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+    __m256 best_policy = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+    __m256i best_index = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    for (int i = 0; i < vector_size; i += 8) {
+        __m256 count = _mm256_loadu_ps(input.count_ + i);
+        __m256 mean = _mm256_loadu_ps(input.mean_ + i);
+        __m256 virtual_loss = _mm256_loadu_ps(input.virtual_loss_ + i);
+        __m256 policy = _mm256_loadu_ps(input.policy_ + i);
+        __m256 reward = _mm256_loadu_ps(input.reward_ + i);
+        __m256 count_with_virtual_loss = _mm256_add_ps(count, virtual_loss);
+
+        __m256 value_u = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(puct_factor, policy), sqrt_total_simulation), _mm256_add_ps(one, count_with_virtual_loss));
+        __m256 value_q = calculateNormalizedMean(input, count, mean, virtual_loss, reward, count_with_virtual_loss);
+        value_q = _mm256_blendv_ps(value_q, init_q, _mm256_cmp_ps(count_with_virtual_loss, _mm256_setzero_ps(), _CMP_EQ_OQ));
+        __m256 score = _mm256_add_ps(value_u, value_q);
+
+        __m256 better = _mm256_or_ps(_mm256_cmp_ps(score, best_score, _CMP_GT_OQ),
+                                     _mm256_and_ps(_mm256_cmp_ps(score, best_score, _CMP_EQ_OQ), _mm256_cmp_ps(policy, best_policy, _CMP_GT_OQ)));
+        best_score = _mm256_blendv_ps(best_score, score, better);
+        best_policy = _mm256_blendv_ps(best_policy, policy, better);
+        best_index = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(best_index), _mm256_castsi256_ps(index), better));
+        index = _mm256_add_epi32(index, _mm256_set1_epi32(8));
+    }
+
+    alignas(32) float lane_score[8], lane_policy[8];
+    alignas(32) int lane_index[8];
+    _mm256_store_ps(lane_score, best_score);
+    _mm256_store_ps(lane_policy, best_policy);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lane_index), best_index);
+    int selected = -1;
+    float selected_score = 0.0f, selected_policy = 0.0f;
+    for (int lane = 0; lane < 8; ++lane) {
+        if (lane_index[lane] == -1 || !isBetterPUCTCandidate(lane_score[lane], lane_policy[lane], lane_index[lane], selected_score, selected_policy, selected)) { continue; }
+        selected = lane_index[lane];
+        selected_score = lane_score[lane];
+        selected_policy = lane_policy[lane];
+    }
+    for (int i = vector_size; i < input.size_; ++i) {
+        float score = calculatePUCTScore(input, i, init_q_value);
+        if (!isBetterPUCTCandidate(score, input.policy_[i], i, selected_score, selected_policy, selected)) { continue; }
+        selected = i;
+        selected_score = score;
+        selected_policy = input.policy_[i];
+    }
+    return selected;
+}
+
+std::string getPUCTKernelName() { return "avx2"; }
+
+#else
+
+void sumPUCTVisitedNormalizedMean(const PUCTKernelInput& input, float& sum_of_mean, float& num_visited)
+{
+    sum_of_mean = num_visited = 0.0f;
+    for (int i = 0; i < input.size_; ++i) {
+        const float virtual_loss = loadVirtualLoss(input, i);
+        if (input.count_[i] + virtual_loss == 0) { continue; }
+        sum_of_mean += calculateNormalizedMean(input, i, virtual_loss);
+        num_visited += 1;
+    }
+}
+
+int selectPUCTChildIndex(const PUCTKernelInput& input, float init_q_value)
+{
+    int selected = -1;
+    float selected_score = 0.0f, selected_policy = 0.0f;
+    for (int i = 0; i < input.size_; ++i) {
+        float score = calculatePUCTScore(input, i, init_q_value);
+        if (!isBetterPUCTCandidate(score, input.policy_[i], i, selected_score, selected_policy, selected)) { continue; }
+        selected = i;
+        selected_score = score;
+        selected_policy = input.policy_[i];
+    }
+    return selected;
+}
+
+std::string getPUCTKernelName() { return "scalar"; }
+
+#endif
+
+} // namespace minizero::actor
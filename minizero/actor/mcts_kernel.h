@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+namespace minizero::actor {
+
+// the PUCT statistics of all children of a node, stored as contiguous arrays (structure-of-arrays)
+class PUCTKernelInput {
+public:
+    int size_;
+    const float* count_;
+    const float* mean_;
+    const float* virtual_loss_;
+    const float* policy_;
+    const float* reward_;
+
+    float reward_discount_;
+    float value_sign_;          // -1 if the children belong to the value flipping player, 1 otherwise
+    bool value_rescale_;        // rescale value by the tree value bound
+    bool value_bound_is_empty_; // less than two values in the tree value bound, normalized mean is always 1
+    float value_lower_bound_;
+    float value_upper_bound_;
+    float puct_bias_;
+    float sqrt_total_simulation_;
+};
+
+// calculate the sum of the normalized mean of all children that have been visited (including virtual loss)
+void sumPUCTVisitedNormalizedMean(const PUCTKernelInput& input, float& sum_of_mean, float& num_visited);
+
+// return the index of the child with the maximum PUCT score; ties are broken by policy, then by index
+int selectPUCTChildIndex(const PUCTKernelInput& input, float init_q_value);
+
+// the instruction set used by the kernels, e.g., "scalar", "avx2", "avx512"
+std::string getPUCTKernelName();
+
+} // namespace minizero::actor
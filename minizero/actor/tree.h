@@ -1,7 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <string>
+#include <utility>
 #include <vector>
 
 namespace minizero::actor {
@@ -24,6 +26,14 @@ public:
         return data_[index];
     }
     inline int size() const { return data_.size(); }
+    inline void keep(const std::vector<int>& indices)
+    {
+        // keep only the data of the given indices, the i-th kept data is moved to index i
+        std::vector<Data> data;
+        data.reserve(indices.size());
+        for (int index : indices) { data.push_back(std::move(data_[index])); }
+        data_ = std::move(data);
+    }
 
 private:
     std::vector<Data> data_;
@@ -70,10 +80,10 @@ public:
 
     inline TreeNode* allocateNodes(int size)
     {
-        assert(current_node_size_ + size <= 1 + tree_node_size_);
-        TreeNode* node = getNodeIndex(current_node_size_);
-        current_node_size_ += size;
-        return node;
+        // lock-free, so that different threads can expand different leaves concurrently
+        uint64_t index = current_node_size_.fetch_add(size);
+        assert(index + size <= 1 + tree_node_size_);
+        return getNodeIndex(index);
     }
 
     std::string toString(const std::string& env_string)
@@ -117,7 +127,7 @@ protected:
     virtual TreeNode* getNodeIndex(int index) = 0;
 
     uint64_t tree_node_size_;
-    uint64_t current_node_size_;
+    std::atomic<uint64_t> current_node_size_;
     TreeNode* nodes_;
 };
 
@@ -20,6 +20,51 @@ void MCTSSearchData::clear()
     node_path_.clear();
 }
 
+int TreeParallelSharedData::getNextJobIndex(int num_jobs)
+{
+    std::lock_guard lock(mutex_);
+    return (job_index_ < num_jobs ? job_index_++ : num_jobs);
+}
+
+void TreeParallelSharedData::addQuery(const TreeParallelQuery& query)
+{
+    std::lock_guard lock(mutex_);
+    queries_.push_back(query);
+}
+
+void TreeParallelSlaveThread::initialize()
+{
+    int seed = config::program_auto_seed ? std::random_device()() : config::program_seed + id_;
+    utils::Random::seed(seed);
+}
+
+void TreeParallelSlaveThread::runJob()
+{
+    std::shared_ptr<TreeParallelSharedData> shared_data = getSharedData();
+    if (shared_data->phase_ == TreeParallelSharedData::Phase::kSelection) {
+        for (int index = shared_data->getNextJobIndex(shared_data->batch_size_); index < shared_data->batch_size_; index = shared_data->getNextJobIndex(shared_data->batch_size_)) {
+            shared_data->actor_->treeParallelSelection(*shared_data, index);
+        }
+    } else {
+        const int num_queries = shared_data->queries_.size();
+        for (int index = shared_data->getNextJobIndex(num_queries); index < num_queries; index = shared_data->getNextJobIndex(num_queries)) {
+            shared_data->actor_->treeParallelUpdate(*shared_data, shared_data->queries_[index]);
+        }
+    }
+}
+
+TreeParallelSearch::TreeParallelSearch(ZeroActor* actor, int num_threads)
+{
+    createSlaveThreads(num_threads);
+    getSharedData()->actor_ = actor;
+}
+
+void TreeParallelSearch::runPhase(TreeParallelSharedData::Phase phase)
+{
+    getSharedData()->phase_ = phase;
+    run();
+}
+
 void ZeroActor::reset()
 {
     BaseActor::reset();
@@ -28,9 +73,18 @@ void ZeroActor::reset()
 
 void ZeroActor::resetSearch()
 {
-    BaseActor::resetSearch();
+    MCTSNode* subtree_root = findReusableSubtree();
+    if (subtree_root) {
+        nn_evaluation_batch_id_ = -1;
+        getMCTS()->reuseSubtree(subtree_root);
+        if (muzero_network_ && !removeIllegalChildren(getMCTS()->getRootNode())) { subtree_root = nullptr; }
+    }
+    if (!subtree_root) { BaseActor::resetSearch(); }
     mcts_search_data_.node_path_.clear();
     getMCTS()->getRootNode()->setAction(Action(-1, env::getPreviousPlayer(env_.getTurn(), env_.getNumPlayer())));
+    if (subtree_root) { addNoiseToNodeChildren(getMCTS()->getRootNode()); }
+    num_reused_simulation_ = getMCTS()->getNumSimulation();
+    tree_action_history_ = env_.getActionHistory();
 }
 
 Action ZeroActor::think(bool with_play /*= false*/, bool display_board /*= false*/)
@@ -38,7 +92,11 @@ Action ZeroActor::think(bool with_play /*= false*/, bool display_board /*= false
     resetSearch();
     boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
     while (!isSearchDone()) {
-        step();
+        if (useTreeParallelSearch()) {
+            treeParallelStep();
+        } else {
+            step();
+        }
         int spent_million_second = (utils::TimeSystem::getLocalTime() - start_ptime).total_milliseconds();
         if (config::actor_mcts_think_time_limit > 0 && spent_million_second >= config::actor_mcts_think_time_limit * 1000) { break; }
     }
@@ -52,7 +110,24 @@ void ZeroActor::beforeNNEvaluation()
 {
     mcts_search_data_.node_path_ = selection();
     if (alphazero_network_) {
-        Environment env_transition = getEnvironmentTransition(mcts_search_data_.node_path_);
+        Environment& env_transition = getLeafEnvironment();
+        getEnvironmentTransition(mcts_search_data_.node_path_, env_transition);
+
+        // leaves found in the NN evaluation cache are evaluated immediately without the network
+        network::NNEvaluationCache::Entry cache_entry;
+        while (alphazero_network_->getNNEvaluationCache().lookup(env_transition.getFeatureHashKey(), cache_entry)) {
+            feature_rotation_ = cache_entry.rotation_;
+            is_cached_network_output_ = true;
+            afterNNEvaluation(cache_entry.network_output_);
+            is_cached_network_output_ = false;
+            if (isSearchDone()) {
+                nn_evaluation_batch_id_ = -1;
+                return;
+            }
+            mcts_search_data_.node_path_ = selection();
+            getEnvironmentTransition(mcts_search_data_.node_path_, env_transition);
+        }
+
         feature_rotation_ = config::actor_use_random_rotation_features ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
         nn_evaluation_batch_id_ = alphazero_network_->pushBack(env_transition.getFeatures(feature_rotation_));
     } else if (muzero_network_) {
@@ -76,11 +151,12 @@ void ZeroActor::afterNNEvaluation(const std::shared_ptr<NetworkOutput>& network_
     const std::vector<MCTSNode*>& node_path = mcts_search_data_.node_path_;
     MCTSNode* leaf_node = node_path.back();
     if (alphazero_network_) {
-        Environment env_transition = getEnvironmentTransition(node_path);
+        const Environment& env_transition = getLeafEnvironment(); // already transitioned in beforeNNEvaluation()
         if (!env_transition.isTerminal()) {
             std::shared_ptr<AlphaZeroNetworkOutput> alphazero_output = std::static_pointer_cast<AlphaZeroNetworkOutput>(network_output);
             getMCTS()->expand(leaf_node, calculateAlphaZeroActionPolicy(env_transition, alphazero_output, feature_rotation_));
             getMCTS()->backup(node_path, alphazero_output->value_, env_transition.getReward());
+            if (!is_cached_network_output_) { alphazero_network_->getNNEvaluationCache().store(env_transition.getFeatureHashKey(), feature_rotation_, network_output); }
         } else {
             getMCTS()->backup(node_path, env_transition.getEvalScore(), env_transition.getReward());
         }
@@ -104,6 +180,7 @@ void ZeroActor::setNetwork(const std::shared_ptr<network::Network>& network)
     muzero_network_ = nullptr;
     if (network->getNetworkTypeName() == "alphazero") {
         alphazero_network_ = std::static_pointer_cast<AlphaZeroNetwork>(network);
+        if (alphazero_network_->getNNEvaluationCache().getSize() != config::actor_nn_evaluation_cache_size) { alphazero_network_->getNNEvaluationCache().resize(config::actor_nn_evaluation_cache_size); }
     } else if (network->getNetworkTypeName() == "muzero" || network->getNetworkTypeName() == "muzero_atari") {
         muzero_network_ = std::static_pointer_cast<MuZeroNetwork>(network);
     } else {
@@ -137,17 +214,21 @@ void ZeroActor::step()
 
     std::vector<std::tuple<int, utils::Rotation, decltype(mcts_search_data_.node_path_)>> batch_queries; // batch id, rotation, search path
     for (int batch_id = 0; batch_id < batch_size; batch_id++) {
+        env_transition_id_ = batch_id;
         beforeNNEvaluation();
+        if (nn_evaluation_batch_id_ == -1) { break; } // the search is done by the evaluations in the NN evaluation cache
         assert(nn_evaluation_batch_id_ == batch_id);
         if (mcts_search_data_.node_path_.back()->getVirtualLoss() == 0) {
             batch_queries.emplace_back(nn_evaluation_batch_id_, feature_rotation_, mcts_search_data_.node_path_);
         }
         for (auto node : mcts_search_data_.node_path_) { node->addVirtualLoss(); }
     }
+    if (batch_queries.empty()) { return; }
     auto network_output = alphazero_network_ ? alphazero_network_->forward()
                                              : (num_simulation == 0 ? muzero_network_->initialInference() : muzero_network_->recurrentInference());
     for (auto& query : batch_queries) {
         nn_evaluation_batch_id_ = std::get<0>(query);
+        env_transition_id_ = nn_evaluation_batch_id_;
         feature_rotation_ = std::get<1>(query);
         mcts_search_data_.node_path_ = std::get<2>(query);
         afterNNEvaluation(network_output[nn_evaluation_batch_id_]);
@@ -156,6 +237,70 @@ void ZeroActor::step()
     }
 }
 
+void ZeroActor::treeParallelStep()
+{
+    // each step consists of three phases:
+    // 1. all threads select leaves concurrently and push their features into the network
+    // 2. the current thread forwards the whole batch
+    // 3. all threads expand leaves and back up values concurrently
+    if (!tree_parallel_search_) { tree_parallel_search_ = std::make_shared<TreeParallelSearch>(this, config::actor_mcts_num_threads); }
+    std::shared_ptr<TreeParallelSharedData> shared_data = tree_parallel_search_->getSharedData();
+    // each thread selects at least one leaf per step, otherwise the other threads only wait at the barriers
+    shared_data->batch_size_ = std::min(std::max(config::actor_mcts_think_batch_size, config::actor_mcts_num_threads), config::actor_num_simulation + 1 - getMCTS()->getNumSimulation());
+    if (static_cast<int>(shared_data->env_transitions_.size()) < shared_data->batch_size_) { shared_data->env_transitions_.resize(shared_data->batch_size_); }
+    shared_data->queries_.clear();
+    shared_data->network_outputs_.clear();
+    tree_parallel_search_->runPhase(TreeParallelSharedData::Phase::kSelection);
+    if (alphazero_network_->getBatchSize() > 0) { shared_data->network_outputs_ = alphazero_network_->forward(); }
+    tree_parallel_search_->runPhase(TreeParallelSharedData::Phase::kUpdate);
+    if (isSearchDone()) { handleSearchDone(); }
+}
+
+void ZeroActor::treeParallelSelection(TreeParallelSharedData& shared_data, int job_index)
+{
+    // node statistics are only read during selection; virtual losses are the only statistics modified concurrently
+    TreeParallelQuery query;
+    query.node_path_ = selection();
+    for (size_t i = 0; i + 1 < query.node_path_.size(); ++i) { query.node_path_[i]->addVirtualLossAtomically(); }
+    if (query.node_path_.back()->addVirtualLossAtomically() > 0) { return; } // another thread is already evaluating the same leaf
+
+    query.env_transition_id_ = job_index; // each job owns one environment, so no lock is needed
+    Environment& env_transition = shared_data.env_transitions_[query.env_transition_id_];
+    getEnvironmentTransition(query.node_path_, env_transition);
+    network::NNEvaluationCache::Entry cache_entry;
+    if (alphazero_network_->getNNEvaluationCache().lookup(env_transition.getFeatureHashKey(), cache_entry)) {
+        query.batch_index_ = -1;
+        query.rotation_ = cache_entry.rotation_;
+        query.cached_network_output_ = cache_entry.network_output_;
+    } else {
+        query.rotation_ = config::actor_use_random_rotation_features ? static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize)) : utils::Rotation::kRotationNone;
+        query.batch_index_ = (env_transition.isTerminal() ? -1 : alphazero_network_->pushBack(env_transition.getFeatures(query.rotation_)));
+    }
+    shared_data.addQuery(query);
+}
+
+void ZeroActor::treeParallelUpdate(TreeParallelSharedData& shared_data, const TreeParallelQuery& query)
+{
+    MCTSNode* leaf_node = query.node_path_.back();
+    const Environment& env_transition = shared_data.env_transitions_[query.env_transition_id_];
+    if (!env_transition.isTerminal()) {
+        std::shared_ptr<NetworkOutput> network_output = (query.cached_network_output_ ? query.cached_network_output_ : shared_data.network_outputs_[query.batch_index_]);
+        std::shared_ptr<AlphaZeroNetworkOutput> alphazero_output = std::static_pointer_cast<AlphaZeroNetworkOutput>(network_output);
+        if (!query.cached_network_output_) { alphazero_network_->getNNEvaluationCache().store(env_transition.getFeatureHashKey(), query.rotation_, network_output); }
+        getMCTS()->expand(leaf_node, calculateAlphaZeroActionPolicy(env_transition, alphazero_output, query.rotation_));
+        if (leaf_node == getMCTS()->getRootNode()) { addNoiseToNodeChildren(leaf_node); }
+        std::lock_guard lock(shared_data.backup_mutex_); // mean and count of a node must be updated together, and the tree value bound is shared
+        getMCTS()->backup(query.node_path_, alphazero_output->value_, env_transition.getReward());
+    } else {
+        std::lock_guard lock(shared_data.backup_mutex_);
+        getMCTS()->backup(query.node_path_, env_transition.getEvalScore(), env_transition.getReward());
+    }
+
+    // the virtual loss of the leaf also includes the threads that collided with this query
+    float virtual_loss = leaf_node->getVirtualLoss();
+    for (auto node : query.node_path_) { node->removeVirtualLossAtomically(virtual_loss); }
+}
+
 void ZeroActor::handleSearchDone()
 {
     mcts_search_data_.selected_node_ = decideActionNode();
@@ -168,6 +313,11 @@ void ZeroActor::handleSearchDone()
         << " (" << action.getActionID() << ")"
         << ", reward: " << env_.getReward()
         << ", player: " << env::playerToChar(action.getPlayer());
+    if (config::actor_mcts_reuse_tree) { oss << ", reused simulations: " << num_reused_simulation_; }
+    if (alphazero_network_ && alphazero_network_->getNNEvaluationCache().isEnabled()) {
+        const network::NNEvaluationCache& cache = alphazero_network_->getNNEvaluationCache();
+        oss << ", nn cache hit rate: " << cache.getHitRate() << " (" << cache.getNumHits() << "/" << cache.getNumLookups() << ")";
+    }
     if (config::actor_mcts_value_rescale) { oss << ", value bound: (" << getMCTS()->getTreeValueBound().begin()->first << ", " << getMCTS()->getTreeValueBound().rbegin()->first << ")"; }
     oss << std::endl
         << "  root node info: " << getMCTS()->getRootNode()->toString() << std::endl
@@ -212,6 +362,43 @@ void ZeroActor::addNoiseToNodeChildren(MCTSNode* node)
     }
 }
 
+MCTSNode* ZeroActor::findReusableSubtree()
+{
+    if (!config::actor_mcts_reuse_tree || config::actor_use_gumbel || !search_) { return nullptr; }
+
+    // the tree can only be reused if actions have been played after the search
+    const std::vector<Action>& action_history = env_.getActionHistory();
+    if (action_history.size() <= tree_action_history_.size()) { return nullptr; }
+    for (size_t i = 0; i < tree_action_history_.size(); ++i) {
+        if (action_history[i].getActionID() != tree_action_history_[i].getActionID() || action_history[i].getPlayer() != tree_action_history_[i].getPlayer()) { return nullptr; }
+    }
+
+    MCTSNode* node = getMCTS()->getRootNode();
+    for (size_t i = tree_action_history_.size(); i < action_history.size() && node; ++i) {
+        MCTSNode* next_node = nullptr;
+        for (int j = 0; j < node->getNumChildren() && !next_node; ++j) {
+            MCTSNode* child = node->getChild(j);
+            if (child->getAction().getActionID() == action_history[i].getActionID()) { next_node = child; }
+        }
+        node = next_node;
+    }
+    return (node && !node->isLeaf() ? node : nullptr);
+}
+
+bool ZeroActor::removeIllegalChildren(MCTSNode* node)
+{
+    // the children of non-root nodes in MuZero are not filtered by the legal actions
+    int num_legal_children = 0;
+    for (int i = 0; i < node->getNumChildren(); ++i) {
+        MCTSNode* child = node->getChild(i);
+        if (!env_.isLegalAction(child->getAction())) { continue; }
+        if (num_legal_children != i) { node->getChild(num_legal_children)->copyFrom(*child); }
+        ++num_legal_children;
+    }
+    node->setNumChildren(num_legal_children);
+    return (num_legal_children > 0);
+}
+
 std::vector<MCTS::ActionCandidate> ZeroActor::calculateAlphaZeroActionPolicy(const Environment& env_transition, const std::shared_ptr<network::AlphaZeroNetworkOutput>& alphazero_output, const utils::Rotation& rotation)
 {
     assert(alphazero_network_);
@@ -244,11 +431,17 @@ std::vector<MCTS::ActionCandidate> ZeroActor::calculateMuZeroActionPolicy(MCTSNo
     return action_candidates;
 }
 
-Environment ZeroActor::getEnvironmentTransition(const std::vector<MCTSNode*>& node_path)
+void ZeroActor::getEnvironmentTransition(const std::vector<MCTSNode*>& node_path, Environment& env_transition)
+{
+    // assigning to an existing environment reuses its allocated memory instead of constructing a new copy
+    env_transition = env_;
+    for (size_t i = 1; i < node_path.size(); ++i) { env_transition.act(node_path[i]->getAction()); }
+}
+
+Environment& ZeroActor::getLeafEnvironment()
 {
-    Environment env = env_;
-    for (size_t i = 1; i < node_path.size(); ++i) { env.act(node_path[i]->getAction()); }
-    return env;
+    if (env_transition_id_ >= static_cast<int>(env_transitions_.size())) { env_transitions_.resize(env_transition_id_ + 1); }
+    return env_transitions_[env_transition_id_];
 }
 
 } // namespace minizero::actor
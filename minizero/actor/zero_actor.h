@@ -5,7 +5,9 @@
 #include "gumbel_zero.h"
 #include "mcts.h"
 #include "muzero_network.h"
+#include "paralleler.h"
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -21,6 +23,66 @@ public:
     void clear();
 };
 
+class ZeroActor;
+
+class TreeParallelQuery {
+public:
+    int batch_index_; // -1 for leaves not evaluated by the network, i.e., terminal leaves or leaves found in the NN evaluation cache
+    int env_transition_id_; // the index of the environment of the leaf in TreeParallelSharedData::env_transitions_
+    utils::Rotation rotation_;
+    std::vector<MCTSNode*> node_path_;
+    std::shared_ptr<network::NetworkOutput> cached_network_output_;
+};
+
+class TreeParallelSharedData : public utils::BaseSharedData {
+public:
+    enum class Phase {
+        kSelection,
+        kUpdate
+    };
+
+    int getNextJobIndex(int num_jobs);
+    void addQuery(const TreeParallelQuery& query);
+
+    Phase phase_;
+    int job_index_;
+    int batch_size_;
+    ZeroActor* actor_;
+    std::mutex mutex_;
+    std::mutex backup_mutex_;
+    std::vector<TreeParallelQuery> queries_;
+    std::vector<Environment> env_transitions_;
+    std::vector<std::shared_ptr<network::NetworkOutput>> network_outputs_;
+};
+
+class TreeParallelSlaveThread : public utils::BaseSlaveThread {
+public:
+    TreeParallelSlaveThread(int id, std::shared_ptr<utils::BaseSharedData> shared_data)
+        : BaseSlaveThread(id, shared_data) {}
+
+    void initialize() override;
+    void runJob() override;
+    bool isDone() override { return false; }
+
+protected:
+    inline std::shared_ptr<TreeParallelSharedData> getSharedData() { return std::static_pointer_cast<TreeParallelSharedData>(shared_data_); }
+};
+
+// runs selection, expansion and backup of a single MCTS tree with multiple threads
+class TreeParallelSearch : public utils::BaseParalleler {
+public:
+    TreeParallelSearch(ZeroActor* actor, int num_threads);
+
+    void runPhase(TreeParallelSharedData::Phase phase);
+    void initialize() override { getSharedData()->job_index_ = 0; }
+    void summarize() override {}
+    inline std::shared_ptr<TreeParallelSharedData> getSharedData() { return std::static_pointer_cast<TreeParallelSharedData>(shared_data_); }
+
+protected:
+    void createSharedData() override { shared_data_ = std::make_shared<TreeParallelSharedData>(); }
+    std::shared_ptr<utils::BaseSlaveThread> newSlaveThread(int id) override { return std::make_shared<TreeParallelSlaveThread>(id, shared_data_); }
+};
+
 class ZeroActor : public BaseActor {
 public:
     ZeroActor(uint64_t tree_node_size)
@@ -28,6 +90,8 @@ public:
     {
         alphazero_network_ = nullptr;
         muzero_network_ = nullptr;
+        env_transition_id_ = 0;
+        is_cached_network_output_ = false;
     }
 
     void reset() override;
@@ -41,32 +105,48 @@ public:
     std::string getSearchInfo() const override { return mcts_search_data_.search_info_; }
     void setNetwork(const std::shared_ptr<network::Network>& network) override;
     std::shared_ptr<Search> createSearch() override { return std::make_shared<MCTS>(tree_node_size_); }
+    inline int getNumReusedSimulation() const { return num_reused_simulation_; }
     std::shared_ptr<MCTS> getMCTS() { return std::static_pointer_cast<MCTS>(search_); }
     const std::shared_ptr<MCTS> getMCTS() const { return std::static_pointer_cast<MCTS>(search_); }
 
 protected:
+    friend class TreeParallelSlaveThread;
+
     std::vector<std::pair<std::string, std::string>> getActionInfo() const override;
     std::string getMCTSPolicy() const override { return (config::actor_use_gumbel ? gumbel_zero_.getMCTSPolicy(getMCTS()) : getMCTS()->getSearchDistributionString()); }
     std::string getMCTSValue() const override { return std::to_string(getMCTS()->getRootNode()->getMean()); }
     std::string getEnvReward() const override;
 
     virtual void step();
+    virtual void treeParallelStep();
+    virtual void treeParallelSelection(TreeParallelSharedData& shared_data, int job_index);
+    virtual void treeParallelUpdate(TreeParallelSharedData& shared_data, const TreeParallelQuery& query);
+    virtual bool useTreeParallelSearch() const { return config::actor_mcts_num_threads > 1 && alphazero_network_ && !config::actor_use_gumbel; }
     virtual void handleSearchDone();
     virtual MCTSNode* decideActionNode();
     virtual void addNoiseToNodeChildren(MCTSNode* node);
+    virtual MCTSNode* findReusableSubtree();
+    virtual bool removeIllegalChildren(MCTSNode* node);
     virtual std::vector<MCTSNode*> selection() { return (config::actor_use_gumbel ? gumbel_zero_.selection(getMCTS()) : getMCTS()->select()); }
 
     std::vector<MCTS::ActionCandidate> calculateAlphaZeroActionPolicy(const Environment& env_transition, const std::shared_ptr<network::AlphaZeroNetworkOutput>& alphazero_output, const utils::Rotation& rotation);
     std::vector<MCTS::ActionCandidate> calculateMuZeroActionPolicy(MCTSNode* leaf_node, const std::shared_ptr<network::MuZeroNetworkOutput>& muzero_output);
-    virtual Environment getEnvironmentTransition(const std::vector<MCTSNode*>& node_path);
+    virtual void getEnvironmentTransition(const std::vector<MCTSNode*>& node_path, Environment& env_transition);
+    Environment& getLeafEnvironment();
 
     bool enable_resign_;
+    int num_reused_simulation_;
     GumbelZero gumbel_zero_;
     uint64_t tree_node_size_;
     MCTSSearchData mcts_search_data_;
+    std::vector<Action> tree_action_history_; // the action history of the environment at the root of the search tree
     utils::Rotation feature_rotation_;
+    bool is_cached_network_output_; // true while afterNNEvaluation() evaluates a leaf found in the NN evaluation cache, which is not stored again
+    int env_transition_id_;                     // the index of the environment of the leaf of mcts_search_data_.node_path_ in env_transitions_
+    std::vector<Environment> env_transitions_; // environments of the selected leaves, carried from selection to expansion
     std::shared_ptr<network::AlphaZeroNetwork> alphazero_network_;
     std::shared_ptr<network::MuZeroNetwork> muzero_network_;
+    std::shared_ptr<TreeParallelSearch> tree_parallel_search_;
 };
 
 } // namespace minizero::actor
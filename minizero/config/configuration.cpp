@@ -15,6 +15,9 @@ float actor_mcts_puct_init = 1.25;
 float actor_mcts_reward_discount = 1.0f;
 int actor_mcts_think_batch_size = 1;
 float actor_mcts_think_time_limit = 0;
+int actor_mcts_num_threads = 1;
+bool actor_mcts_reuse_tree = false;
+int actor_nn_evaluation_cache_size = 0;
 bool actor_mcts_value_rescale = false;
 char actor_mcts_value_flipping_player = 'W';
 bool actor_select_action_by_count = false;
@@ -44,7 +47,17 @@ int zero_replay_buffer = 20;
 float zero_disable_resign_ratio = 0.1;
 int zero_actor_intermediate_sequence_length = 0;
 std::string zero_actor_ignored_command = "reset_actors";
+int zero_actor_num_cohorts = 1;
+bool zero_actor_compress_game_output = false;
+bool zero_actor_binary_protocol = false;
 bool zero_server_accept_different_model_games = true;
+bool zero_server_write_binary_records = false;
+int zero_server_num_io_threads = 4;
+int zero_server_num_parse_threads = 4;
+bool zero_server_binary_protocol = true;
+bool zero_server_compress_self_play_records = false;
+bool zero_server_async_optimization = false;
+int zero_server_num_op_workers = 1;
 
 // learner parameters
 bool learner_use_per = false;
@@ -61,6 +74,8 @@ float learner_momentum = 0.9;
 float learner_weight_decay = 0.0001;
 float learner_value_loss_scale = 1.0f;
 int learner_num_thread = 8;
+bool learner_cache_features = true;
+int learner_num_prefetch_batches = 0;
 
 // network parameters
 std::string nn_file_name = "";
@@ -96,6 +111,9 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("actor_mcts_value_rescale", actor_mcts_value_rescale, "true for games whose rewards are not bounded in [-1, 1], e.g., Atari games", "Actor");             // ref: MZ
     cl.addParameter("actor_mcts_think_batch_size", actor_mcts_think_batch_size, "the MCTS selection batch size; only works when running console", "Actor");
     cl.addParameter("actor_mcts_think_time_limit", actor_mcts_think_time_limit, "the MCTS time limit in seconds, 0 represents disabling time limit (only uses actor_num_simulation); only works when running console", "Actor");
+    cl.addParameter("actor_mcts_num_threads", actor_mcts_num_threads, "the number of threads searching the same MCTS tree in parallel (tree parallelization), 1 represents single-threaded search; the selection batch size is at least the number of threads; only works for AlphaZero without Gumbel when running console", "Actor");
+    cl.addParameter("actor_mcts_reuse_tree", actor_mcts_reuse_tree, "true for keeping the subtree of the played actions as the new search tree instead of searching from scratch; does not work with actor_use_gumbel", "Actor");
+    cl.addParameter("actor_nn_evaluation_cache_size", actor_nn_evaluation_cache_size, "the number of entries of the NN evaluation cache, which reuses the AlphaZero network outputs of transpositions; 0 represents disabling the cache", "Actor");
     cl.addParameter("actor_select_action_by_count", actor_select_action_by_count, "true for selecting the action by the maximum MCTS count; should not be true together with actor_select_action_by_softmax_count", "Actor");
     cl.addParameter("actor_select_action_by_softmax_count", actor_select_action_by_softmax_count, "true for selecting the action by the propotion of MCTS count; should not be true together with actor_select_action_by_count", "Actor");
     cl.addParameter("actor_select_action_softmax_temperature", actor_select_action_softmax_temperature, "the softmax temperature when using actor_select_action_by_softmax_count", "Actor");
@@ -123,7 +141,17 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("zero_disable_resign_ratio", zero_disable_resign_ratio, "the probability to keep playing when the winrate is below actor_resign_threshold", "Zero");                                                       // ref: AZ, Sec. Methods
     cl.addParameter("zero_actor_intermediate_sequence_length", zero_actor_intermediate_sequence_length, "the max sequence length when running self-play; usually 0 (unlimited) for board games, 200 for atari games", "Zero"); // ref: MZ
     cl.addParameter("zero_actor_ignored_command", zero_actor_ignored_command, "the commands to ignore by the actor; format: command1 command2 ...", "Zero");
+    cl.addParameter("zero_actor_num_cohorts", zero_actor_num_cohorts, "the number of actor cohorts; with more than one cohort, the CPU jobs of a cohort overlap with the network forward of another cohort", "Zero");
+    cl.addParameter("zero_actor_compress_game_output", zero_actor_compress_game_output, "true for sending self-play games compressed by gzip to the server", "Zero");
+    cl.addParameter("zero_actor_binary_protocol", zero_actor_binary_protocol, "true for sending self-play games to the server in length-prefixed binary frames instead of text lines; usually set by the server when the worker supports it", "Zero");
     cl.addParameter("zero_server_accept_different_model_games", zero_server_accept_different_model_games, "true for accepting self-play games generated by out-of-date model", "Zero");
+    cl.addParameter("zero_server_write_binary_records", zero_server_write_binary_records, "true for also saving self-play games in a binary format (sgf/[iteration].bin), which is much faster for the learner to load", "Zero");
+    cl.addParameter("zero_server_num_io_threads", zero_server_num_io_threads, "the number of threads that the zero server uses to communicate with workers", "Zero");
+    cl.addParameter("zero_server_num_parse_threads", zero_server_num_parse_threads, "the number of threads that the zero server uses to parse self-play games received from workers", "Zero");
+    cl.addParameter("zero_server_binary_protocol", zero_server_binary_protocol, "true for letting the self-play workers that support it send games in binary frames; otherwise, games are sent as text lines", "Zero");
+    cl.addParameter("zero_server_compress_self_play_records", zero_server_compress_self_play_records, "true for saving self-play games compressed by gzip (sgf/[iteration].sgf.gz) instead of sgf/[iteration].sgf, which the learner reads directly", "Zero");
+    cl.addParameter("zero_server_async_optimization", zero_server_async_optimization, "true for optimizing the previous iterations while self-play continues with the latest model, which is loaded by self-play workers without stopping; otherwise, self-play stops during each optimization", "Zero");
+    cl.addParameter("zero_server_num_op_workers", zero_server_num_op_workers, "the number of op workers that train together in data parallel, each of which loads a shard of the replay buffer and samples learner_batch_size data per step, i.e., the effective batch size is multiplied by this number; the optimization waits until all of them are connected", "Zero");
 
     // learner parameters
     cl.addParameter("learner_use_per", learner_use_per, "true for enabling Prioritized Experience Replay", "Learner");                                                              // ref: PER
@@ -140,6 +168,8 @@ void setConfiguration(ConfigureLoader& cl)
     cl.addParameter("learner_weight_decay", learner_weight_decay, "hyperparameter for weight decay", "Learner");
     cl.addParameter("learner_value_loss_scale", learner_value_loss_scale, "hyperparameter for scaling of the value loss", "Learner");
     cl.addParameter("learner_num_thread", learner_num_thread, "the number of threads for training", "Learner");
+    cl.addParameter("learner_cache_features", learner_cache_features, "true for caching the board of each position when loading games, which speeds up sampling training data at the cost of memory", "Learner");
+    cl.addParameter("learner_num_prefetch_batches", learner_num_prefetch_batches, "the number of batches filled in the background while training; 0 for filling each batch when it is requested", "Learner");
 
     // network parameters
     cl.addParameter("nn_file_name", nn_file_name, "the file name of model weights", "Network");
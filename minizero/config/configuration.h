@@ -17,6 +17,9 @@ extern float actor_mcts_puct_init;
 extern float actor_mcts_reward_discount;
 extern int actor_mcts_think_batch_size;
 extern float actor_mcts_think_time_limit;
+extern int actor_mcts_num_threads;
+extern bool actor_mcts_reuse_tree;
+extern int actor_nn_evaluation_cache_size;
 extern bool actor_mcts_value_rescale;
 extern char actor_mcts_value_flipping_player;
 extern bool actor_select_action_by_count;
@@ -46,7 +49,17 @@ extern int zero_replay_buffer;
 extern float zero_disable_resign_ratio;
 extern int zero_actor_intermediate_sequence_length;
 extern std::string zero_actor_ignored_command;
+extern int zero_actor_num_cohorts;
+extern bool zero_actor_compress_game_output;
+extern bool zero_actor_binary_protocol;
 extern bool zero_server_accept_different_model_games;
+extern bool zero_server_write_binary_records;
+extern int zero_server_num_io_threads;
+extern int zero_server_num_parse_threads;
+extern bool zero_server_binary_protocol;
+extern bool zero_server_compress_self_play_records;
+extern bool zero_server_async_optimization;
+extern int zero_server_num_op_workers;
 
 // learner parameters
 extern bool learner_use_per;
@@ -63,6 +76,8 @@ extern float learner_momentum;
 extern float learner_weight_decay;
 extern float learner_value_loss_scale;
 extern int learner_num_thread;
+extern bool learner_cache_features;
+extern int learner_num_prefetch_batches;
 
 // network parameters
 extern std::string nn_file_name;
@@ -0,0 +1,720 @@
+#include "benchmark.h"
+#include "alphazero_network.h"
+#include "configuration.h"
+#include "create_actor.h"
+#include "create_network.h"
+#include "environment.h"
+#include "mcts.h"
+#include "paralleler.h"
+#include "random.h"
+#include "time_system.h"
+#include "wire_frame.h"
+#include "zero_server.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace minizero::console {
+
+using namespace minizero;
+
+class BenchmarkMCTS : public actor::MCTS {
+public:
+    BenchmarkMCTS(uint64_t tree_node_size)
+        : MCTS(tree_node_size) {}
+
+    using MCTS::selectChildByPUCTScore;
+};
+
+// the previous layout of network outputs, which copies the outputs of each sample into its own vectors
+class VectorNetworkOutput : public network::NetworkOutput {
+public:
+    VectorNetworkOutput(int policy_size) : value_(0.0f), policy_(policy_size), policy_logits_(policy_size) {}
+    std::shared_ptr<network::NetworkOutput> clone() const override { return std::make_shared<VectorNetworkOutput>(*this); }
+
+    float value_;
+    std::vector<float> policy_;
+    std::vector<float> policy_logits_;
+};
+
+// emulates the CPU jobs of an actor group, where each job only does a small amount of work so that dispatching actors dominates
+class DispatchSharedData : public utils::BaseSharedData {
+public:
+    int getAvailableActorIndexByMutex()
+    {
+        std::lock_guard lock(mutex_);
+        return (actor_index_ < static_cast<int>(actor_states_.size()) ? actor_index_++ : actor_states_.size());
+    }
+
+    std::string dispatch_;
+    int job_size_;
+    int actor_index_;
+    std::mutex mutex_;
+    utils::IndexDispenser actor_dispenser_;
+    std::vector<uint64_t> actor_states_;
+};
+
+class DispatchSlaveThread : public utils::BaseSlaveThread {
+public:
+    DispatchSlaveThread(int id, std::shared_ptr<utils::BaseSharedData> shared_data)
+        : BaseSlaveThread(id, shared_data) {}
+
+    void initialize() override {}
+    bool isDone() override { return false; }
+    void runJob() override
+    {
+        std::shared_ptr<DispatchSharedData> shared_data = std::static_pointer_cast<DispatchSharedData>(shared_data_);
+        const int num_actors = shared_data->actor_states_.size();
+        if (shared_data->dispatch_ == "mutex") {
+            for (int actor_id = shared_data->getAvailableActorIndexByMutex(); actor_id < num_actors; actor_id = shared_data->getAvailableActorIndexByMutex()) { doJob(actor_id); }
+        } else {
+            for (auto chunk = shared_data->actor_dispenser_.getNextChunk(); chunk.first < chunk.second; chunk = shared_data->actor_dispenser_.getNextChunk()) {
+                for (int actor_id = chunk.first; actor_id < chunk.second; ++actor_id) { doJob(actor_id); }
+            }
+        }
+    }
+
+protected:
+    inline void doJob(int actor_id)
+    {
+        std::shared_ptr<DispatchSharedData> shared_data = std::static_pointer_cast<DispatchSharedData>(shared_data_);
+        uint64_t& state = shared_data->actor_states_[actor_id];
+        for (int i = 0; i < shared_data->job_size_; ++i) { state = state * 6364136223846793005ULL + 1442695040888963407ULL; }
+    }
+};
+
+class DispatchParalleler : public utils::BaseParalleler {
+public:
+    DispatchParalleler(int num_threads) { createSlaveThreads(num_threads); }
+
+    void initialize() override { getSharedData()->actor_index_ = 0; }
+    void summarize() override {}
+    inline std::shared_ptr<DispatchSharedData> getSharedData() { return std::static_pointer_cast<DispatchSharedData>(shared_data_); }
+
+protected:
+    void createSharedData() override { shared_data_ = std::make_shared<DispatchSharedData>(); }
+    std::shared_ptr<utils::BaseSlaveThread> newSlaveThread(int id) override { return std::make_shared<DispatchSlaveThread>(id, shared_data_); }
+};
+
+// a zero server that only receives self-play games, which are drained by the benchmark instead of the training loop
+class BenchmarkZeroServer : public zero::ZeroServer {
+public:
+    BenchmarkZeroServer()
+    {
+        // the parts of ZeroServer::initialize() used when receiving games, without creating the logs of a training directory
+        shared_data_.num_op_worker_ = 0;
+        shared_data_.model_iteration_ = 0;
+        self_play_model_iteration_ = 0;
+    }
+
+    using ZeroServer::shared_data_;
+
+    inline int getPort() const { return acceptor_.local_endpoint().port(); }
+
+    // returns false if no game is received before the timeout
+    bool waitSelfPlayData(zero::ZeroSelfPlayData& sp_data, int timeout_ms)
+    {
+        boost::unique_lock<boost::mutex> lock(shared_data_.mutex_);
+        if (!shared_data_.cv_.timed_wait(lock, boost::posix_time::milliseconds(timeout_ms), [this] { return !shared_data_.sp_data_queue_.empty(); })) { return false; }
+        sp_data = std::move(shared_data_.sp_data_queue_.front());
+        shared_data_.sp_data_queue_.pop();
+        return true;
+    }
+
+    void shutdown()
+    {
+        stop();
+        thread_pool_.join_all();
+        shared_data_.stopParsing();
+    }
+};
+
+// plays random games and attaches a random search policy of policy_size actions, value, and reward to each move, like self-play games
+std::vector<EnvironmentLoader> createRandomGames(int num_games, int max_game_length, int policy_size)
+{
+    std::vector<EnvironmentLoader> env_loaders(num_games);
+    for (auto& env_loader : env_loaders) {
+        Environment env;
+        std::vector<std::vector<std::pair<std::string, std::string>>> action_info_history;
+        for (int j = 0; j < max_game_length && !env.isTerminal(); ++j) {
+            std::vector<Action> legal_actions = env.getLegalActions();
+            std::string policy;
+            for (int k = 0; k < std::min(policy_size, static_cast<int>(legal_actions.size())); ++k) { policy += std::to_string(legal_actions[k].getActionID()) + ":" + std::to_string(utils::Random::randInt() % 100 + 1) + ","; }
+            policy.pop_back();
+            action_info_history.push_back({{"P", policy}, {"V", std::to_string(utils::Random::randReal(2.0f) - 1.0f)}, {"R", "0"}});
+            env.act(legal_actions[utils::Random::randInt() % legal_actions.size()]);
+        }
+        env_loader.loadFromEnvironment(env, action_info_history);
+    }
+    return env_loaders;
+}
+
+Benchmark::Benchmark()
+{
+    RegisterFunction("list_benchmarks", this, &Benchmark::cmdListBenchmarks);
+    RegisterFunction("mcts_selection", this, &Benchmark::cmdMCTSSelection);
+    RegisterFunction("selfplay_throughput", this, &Benchmark::cmdSelfPlayThroughput);
+    RegisterFunction("env_transition", this, &Benchmark::cmdEnvTransition);
+    RegisterFunction("network_output_unpacking", this, &Benchmark::cmdNetworkOutputUnpacking);
+    RegisterFunction("actor_dispatch", this, &Benchmark::cmdActorDispatch);
+    RegisterFunction("replay_buffer_loading", this, &Benchmark::cmdReplayBufferLoading);
+    RegisterFunction("feature_sampling", this, &Benchmark::cmdFeatureSampling);
+    RegisterFunction("muzero_unrolling", this, &Benchmark::cmdMuZeroUnrolling);
+    RegisterFunction("feature_rotation", this, &Benchmark::cmdFeatureRotation);
+    RegisterFunction("zero_server_ingestion", this, &Benchmark::cmdZeroServerIngestion);
+    RegisterFunction("self_play_persistence", this, &Benchmark::cmdSelfPlayPersistence);
+}
+
+void Benchmark::executeCommand(std::string command)
+{
+    if (!command.empty() && command.back() == '\r') { command.pop_back(); }
+    std::vector<std::string> args = utils::stringToVector(command);
+    if (args.empty()) { return; }
+
+    if (function_map_.count(args[0]) == 0) {
+        std::cerr << "Unknown benchmark: " << command << std::endl;
+        return;
+    }
+    (*function_map_[args[0]])(args);
+}
+
+void Benchmark::cmdListBenchmarks(const std::vector<std::string>& args)
+{
+    for (const auto& benchmark : function_map_) { std::cout << benchmark.first << std::endl; }
+}
+
+void Benchmark::cmdMCTSSelection(const std::vector<std::string>& args)
+{
+    // format: mcts_selection [num_children] [num_iterations]
+    const int num_children = getArgument(args, 1, 362);
+    const int num_iterations = getArgument(args, 2, 100000);
+
+    // expand a root node with random priors, then spread random statistics over its children to mimic a search in progress
+    BenchmarkMCTS mcts(num_children);
+    mcts.reset();
+    actor::MCTSNode* root = mcts.getRootNode();
+    root->setAction(Action(-1, env::Player::kPlayer2));
+    std::vector<actor::MCTS::ActionCandidate> candidates;
+    for (int i = 0; i < num_children; ++i) { candidates.emplace_back(Action(i, env::Player::kPlayer1), utils::Random::randReal(), 0.0f); }
+    mcts.expand(root, candidates);
+    float total_count = 1.0f;
+    for (int i = 0; i < num_children; ++i) {
+        actor::MCTSNode* child = root->getChild(i);
+        child->setCount(utils::Random::randInt() % 4 == 0 ? utils::Random::randInt() % 50 : 0);
+        child->setMean(utils::Random::randReal(2.0f) - 1.0f);
+        total_count += child->getCount();
+    }
+    root->setCount(total_count);
+
+    int checksum = 0;
+    boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+    for (int i = 0; i < num_iterations; ++i) {
+        actor::MCTSNode* selected = mcts.selectChildByPUCTScore(root);
+        checksum += selected->getAction().getActionID();
+        selected->addVirtualLoss(); // perturb the statistics so that each iteration does real work
+    }
+    double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+#if MCTS_SOA
+    const std::string layout = "soa (" + actor::getPUCTKernelName() + ")";
+#else
+    const std::string layout = "aos";
+#endif
+    report("mcts_selection", {{"layout", layout},
+                              {"children", std::to_string(num_children)},
+                              {"iterations", std::to_string(num_iterations)},
+                              {"ns/selection", std::to_string(elapsed_us * 1000 / num_iterations)},
+                              {"checksum", std::to_string(checksum)}});
+}
+
+void Benchmark::cmdSelfPlayThroughput(const std::vector<std::string>& args)
+{
+    // format: selfplay_throughput [num_moves]
+    // plays the same number of moves with and without tree reuse using nn_file_name and actor_num_simulation, i.e., at a fixed strength
+    const int num_moves = getArgument(args, 1, 100);
+    const bool reuse_tree = config::actor_mcts_reuse_tree;
+
+    std::shared_ptr<network::Network> network = network::createNetwork(config::nn_file_name, 0);
+    uint64_t tree_node_size = static_cast<uint64_t>(config::actor_num_simulation + 1) * network->getActionSize();
+    for (bool enable_reuse_tree : {false, true}) {
+        config::actor_mcts_reuse_tree = enable_reuse_tree;
+        std::shared_ptr<actor::ZeroActor> actor = std::static_pointer_cast<actor::ZeroActor>(actor::createActor(tree_node_size, network));
+        int64_t num_simulation = 0;
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (int i = 0; i < num_moves; ++i) {
+            if (actor->isEnvTerminal()) { actor->reset(); }
+            actor->think(true);
+            num_simulation += actor->getMCTS()->getNumSimulation() - actor->getNumReusedSimulation();
+        }
+        double elapsed_s = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds() / 1e6;
+
+        report("selfplay_throughput", {{"reuse_tree", enable_reuse_tree ? "true" : "false"},
+                                       {"moves", std::to_string(num_moves)},
+                                       {"moves/sec", std::to_string(num_moves / elapsed_s)},
+                                       {"nn_evaluations/move", std::to_string(static_cast<double>(num_simulation) / num_moves)}});
+    }
+    config::actor_mcts_reuse_tree = reuse_tree;
+}
+
+void Benchmark::cmdEnvTransition(const std::vector<std::string>& args)
+{
+    // format: env_transition [num_root_moves] [path_length] [num_iterations]
+    // measures the environment transitions of each simulation, i.e., the part of a simulation that does not depend on the network
+    const int num_root_moves = getArgument(args, 1, 50);
+    const int path_length = getArgument(args, 2, 10);
+    const int num_iterations = getArgument(args, 3, 10000);
+
+    // play random legal moves to build the root environment and a search path below it
+    auto play_random_moves = [](Environment& env, int num_moves) {
+        std::vector<Action> actions;
+        for (int i = 0; i < num_moves && !env.isTerminal(); ++i) {
+            std::vector<Action> legal_actions = env.getLegalActions();
+            actions.push_back(legal_actions[utils::Random::randInt() % legal_actions.size()]);
+            env.act(actions.back());
+        }
+        return actions;
+    };
+    Environment root_env;
+    play_random_moves(root_env, num_root_moves);
+    Environment leaf_env = root_env;
+    std::vector<Action> path = play_random_moves(leaf_env, path_length);
+
+    // copy: copies the root environment and replays the path twice per simulation, once before and once after the evaluation
+    // cached: replays the path once into an environment that is reused across simulations
+    int checksum = 0;
+    for (const std::string transition : {"copy", "cached"}) {
+        Environment cached_env;
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (int i = 0; i < num_iterations; ++i) {
+            if (transition == "copy") {
+                for (int j = 0; j < 2; ++j) {
+                    Environment env = root_env;
+                    for (const auto& action : path) { env.act(action); }
+                    checksum += env.getActionHistory().size();
+                }
+            } else {
+                cached_env = root_env;
+                for (const auto& action : path) { cached_env.act(action); }
+                checksum += cached_env.getActionHistory().size();
+            }
+        }
+        double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        report("env_transition", {{"env", root_env.name()},
+                                  {"transition", transition},
+                                  {"path_length", std::to_string(path.size())},
+                                  {"ns/simulation", std::to_string(elapsed_us * 1000 / num_iterations)},
+                                  {"simulations/sec", std::to_string(num_iterations / (elapsed_us / 1e6))},
+                                  {"checksum", std::to_string(checksum)}});
+    }
+}
+
+void Benchmark::cmdNetworkOutputUnpacking(const std::vector<std::string>& args)
+{
+    // format: network_output_unpacking [batch_size] [policy_size] [num_iterations]
+    // measures the cost of turning the output tensors of a forward into the outputs of each sample
+    const int batch_size = getArgument(args, 1, 2048);
+    const int policy_size = getArgument(args, 2, 362);
+    const int num_iterations = getArgument(args, 3, 100);
+
+    torch::Tensor policy_output = torch::zeros({batch_size, policy_size});
+    torch::Tensor policy_logits_output = torch::zeros({batch_size, policy_size});
+    torch::Tensor value_output = torch::zeros({batch_size, 1});
+
+    double checksum = 0.0;
+    for (const std::string unpacking : {"vector", "view"}) {
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (int i = 0; i < num_iterations; ++i) {
+            if (unpacking == "vector") {
+                std::vector<std::shared_ptr<network::NetworkOutput>> network_outputs;
+                for (int j = 0; j < batch_size; ++j) {
+                    std::shared_ptr<VectorNetworkOutput> output = std::make_shared<VectorNetworkOutput>(policy_size);
+                    std::copy(policy_output.data_ptr<float>() + j * policy_size, policy_output.data_ptr<float>() + (j + 1) * policy_size, output->policy_.begin());
+                    std::copy(policy_logits_output.data_ptr<float>() + j * policy_size, policy_logits_output.data_ptr<float>() + (j + 1) * policy_size, output->policy_logits_.begin());
+                    output->value_ = value_output.data_ptr<float>()[j];
+                    network_outputs.push_back(output);
+                }
+                checksum += std::static_pointer_cast<VectorNetworkOutput>(network_outputs.back())->policy_[0];
+            } else {
+                std::vector<std::shared_ptr<network::NetworkOutput>> network_outputs = network::AlphaZeroNetwork::unpackOutputs(policy_output, policy_logits_output, value_output, batch_size);
+                checksum += std::static_pointer_cast<network::AlphaZeroNetworkOutput>(network_outputs.back())->policy_[0];
+            }
+        }
+        double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        report("network_output_unpacking", {{"unpacking", unpacking},
+                                            {"batch_size", std::to_string(batch_size)},
+                                            {"policy_size", std::to_string(policy_size)},
+                                            {"us/batch", std::to_string(elapsed_us / num_iterations)},
+                                            {"checksum", std::to_string(checksum)}});
+    }
+}
+
+void Benchmark::cmdActorDispatch(const std::vector<std::string>& args)
+{
+    // format: actor_dispatch [num_actors] [num_threads] [num_rounds] [job_size]
+    // compares handing out actors one at a time under a mutex, one at a time with an atomic counter, and in chunks with an atomic counter
+    const int num_actors = getArgument(args, 1, 4096);
+    const int num_threads = getArgument(args, 2, config::zero_num_threads);
+    const int num_rounds = getArgument(args, 3, 1000);
+    const int job_size = getArgument(args, 4, 100);
+
+    DispatchParalleler paralleler(num_threads);
+    std::shared_ptr<DispatchSharedData> shared_data = paralleler.getSharedData();
+    shared_data->job_size_ = job_size;
+    shared_data->actor_states_.assign(num_actors, 0);
+    for (const std::string dispatch : {"mutex", "atomic", "chunked"}) {
+        // the same chunk size as ActorGroup
+        const int num_chunks_per_thread = 4;
+        const int chunk_size = (dispatch == "chunked" ? std::max(1, num_actors / (num_threads * num_chunks_per_thread)) : 1);
+        shared_data->dispatch_ = dispatch;
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (int i = 0; i < num_rounds; ++i) {
+            shared_data->actor_dispenser_.reset(num_actors, chunk_size);
+            paralleler.run();
+        }
+        double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        report("actor_dispatch", {{"dispatch", dispatch},
+                                  {"actors", std::to_string(num_actors)},
+                                  {"threads", std::to_string(num_threads)},
+                                  {"chunk_size", std::to_string(chunk_size)},
+                                  {"us/round", std::to_string(elapsed_us / num_rounds)},
+                                  {"ns/actor", std::to_string(elapsed_us * 1000 / num_rounds / num_actors)}});
+    }
+}
+
+void Benchmark::cmdReplayBufferLoading(const std::vector<std::string>& args)
+{
+    // format: replay_buffer_loading [num_games] [max_game_length] [policy_size]
+    // compares loading self-play games from sgf and from binary records, where each move has a search policy of policy_size actions
+    const int num_games = getArgument(args, 1, 200);
+    const int max_game_length = getArgument(args, 2, 200);
+    const int policy_size = getArgument(args, 3, 32);
+
+    std::vector<std::string> sgf_records, binary_records;
+    for (const auto& env_loader : createRandomGames(num_games, max_game_length, policy_size)) {
+        sgf_records.push_back(env_loader.toString());
+        binary_records.push_back(env_loader.toBinaryString());
+    }
+
+    for (const std::string format : {"sgf", "binary"}) {
+        const std::vector<std::string>& records = (format == "sgf" ? sgf_records : binary_records);
+        size_t num_bytes = 0, num_positions = 0;
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (const auto& record : records) {
+            EnvironmentLoader env_loader;
+            if (format == "sgf") {
+                env_loader.loadFromString(record);
+            } else {
+                env_loader.loadFromBinary(record.data(), record.size());
+            }
+            num_bytes += record.size();
+            num_positions += env_loader.getActionPairs().size();
+        }
+        double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        report("replay_buffer_loading", {{"format", format},
+                                         {"games", std::to_string(num_games)},
+                                         {"positions", std::to_string(num_positions)},
+                                         {"KB/game", std::to_string(num_bytes / 1024.0 / num_games)},
+                                         {"us/game", std::to_string(elapsed_us / num_games)}});
+    }
+}
+
+void Benchmark::cmdFeatureSampling(const std::vector<std::string>& args)
+{
+    // format: feature_sampling [num_games] [max_game_length] [num_samples]
+    // measures the samples per second of a learner thread, i.e., the features and policy of a random position with a random rotation
+    const int num_games = getArgument(args, 1, 100);
+    const int max_game_length = getArgument(args, 2, 200);
+    const int num_samples = getArgument(args, 3, 10000);
+
+    std::vector<EnvironmentLoader> env_loaders = createRandomGames(num_games, max_game_length, 32);
+    for (const std::string features : {"replay", "cached"}) {
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (auto& env_loader : env_loaders) {
+            if (features == "cached") { env_loader.cacheFeatures(); }
+        }
+        double cache_elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        double checksum = 0.0;
+        start_ptime = utils::TimeSystem::getLocalTime();
+        for (int i = 0; i < num_samples; ++i) {
+            const EnvironmentLoader& env_loader = env_loaders[utils::Random::randInt() % num_games];
+            int pos = utils::Random::randInt() % (env_loader.getActionPairs().size() + 1);
+            utils::Rotation rotation = static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize));
+            checksum += env_loader.getFeatures(pos, rotation)[0] + env_loader.getPolicy(pos, rotation)[0];
+        }
+        double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        report("feature_sampling", {{"env", env_loaders[0].name()},
+                                    {"features", features},
+                                    {"samples", std::to_string(num_samples)},
+                                    {"samples/sec", std::to_string(num_samples / (elapsed_us / 1e6))},
+                                    {"us/game to cache", std::to_string(cache_elapsed_us / num_games)},
+                                    {"checksum", std::to_string(checksum)}});
+    }
+}
+
+void Benchmark::cmdMuZeroUnrolling(const std::vector<std::string>& args)
+{
+    // format: muzero_unrolling [num_games] [max_game_length] [num_samples] [num_unrolling_steps]
+    // measures the latency of writing the action features, policy, value, and reward of all unrolling steps of a sample into a batch
+    const int num_games = getArgument(args, 1, 100);
+    const int max_game_length = getArgument(args, 2, 200);
+    const int num_samples = getArgument(args, 3, 10000);
+    const int num_unrolling_steps = getArgument(args, 4, config::learner_muzero_unrolling_step);
+
+    Environment env;
+    const int action_feature_size = env.getNumActionFeatureChannels() * env.getHiddenChannelHeight() * env.getHiddenChannelWidth();
+    const int policy_size = env.getPolicySize();
+    const int value_size = env.getDiscreteValueSize();
+    std::vector<float> batch_action_features(action_feature_size * num_unrolling_steps);
+    std::vector<float> batch_policy(policy_size * (num_unrolling_steps + 1));
+    std::vector<float> batch_value(value_size * (num_unrolling_steps + 1));
+    std::vector<float> batch_reward(value_size * num_unrolling_steps);
+
+    // vector: appends the vectors returned by the getters of each step, then copies them into the batch, i.e., the previous data loader
+    // direct: writes each step into its slice of the batch
+    std::vector<EnvironmentLoader> env_loaders = createRandomGames(num_games, max_game_length, 32);
+    for (const std::string unrolling : {"vector", "direct"}) {
+        double checksum = 0.0;
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (int i = 0; i < num_samples; ++i) {
+            const EnvironmentLoader& env_loader = env_loaders[utils::Random::randInt() % num_games];
+            int pos = utils::Random::randInt() % (env_loader.getActionPairs().size() + 1);
+            utils::Rotation rotation = static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize));
+            if (unrolling == "vector") {
+                std::vector<float> action_features, policy, value, reward, tmp;
+                for (int step = 0; step <= num_unrolling_steps; ++step) {
+                    if (step < num_unrolling_steps) {
+                        tmp = env_loader.getActionFeatures(pos + step, rotation);
+                        action_features.insert(action_features.end(), tmp.begin(), tmp.end());
+                        tmp = env_loader.getReward(pos + step);
+                        reward.insert(reward.end(), tmp.begin(), tmp.end());
+                    }
+                    tmp = env_loader.getPolicy(pos + step, rotation);
+                    policy.insert(policy.end(), tmp.begin(), tmp.end());
+                    tmp = env_loader.getValue(pos + step);
+                    value.insert(value.end(), tmp.begin(), tmp.end());
+                }
+                std::copy(action_features.begin(), action_features.end(), batch_action_features.begin());
+                std::copy(policy.begin(), policy.end(), batch_policy.begin());
+                std::copy(value.begin(), value.end(), batch_value.begin());
+                std::copy(reward.begin(), reward.end(), batch_reward.begin());
+            } else {
+                for (int step = 0; step <= num_unrolling_steps; ++step) {
+                    if (step < num_unrolling_steps) {
+                        env_loader.writeActionFeatures(pos + step, batch_action_features.data() + action_feature_size * step, rotation);
+                        env_loader.writeReward(pos + step, batch_reward.data() + value_size * step);
+                    }
+                    env_loader.writePolicy(pos + step, batch_policy.data() + policy_size * step, rotation);
+                    env_loader.writeValue(pos + step, batch_value.data() + value_size * step);
+                }
+            }
+            checksum += batch_policy[0] + batch_value[0];
+        }
+        double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        report("muzero_unrolling", {{"env", env_loaders[0].name()},
+                                    {"unrolling", unrolling},
+                                    {"unrolling_steps", std::to_string(num_unrolling_steps)},
+                                    {"samples", std::to_string(num_samples)},
+                                    {"us/sample", std::to_string(elapsed_us / num_samples)},
+                                    {"checksum", std::to_string(checksum)}});
+    }
+}
+
+void Benchmark::cmdFeatureRotation(const std::vector<std::string>& args)
+{
+    // format: feature_rotation [board_size] [num_planes]
+    // measures rotating feature planes with a random rotation, either computing each rotated position or looking it up in the rotation table
+    const int board_size = getArgument(args, 1, 19);
+    const int num_planes = getArgument(args, 2, 100000);
+
+    const int board_area = board_size * board_size;
+    std::vector<float> plane(board_area), rotated_plane(board_area);
+    for (auto& value : plane) { value = utils::Random::randInt() % 2; }
+    for (const std::string rotation_method : {"calculate", "table"}) {
+        double checksum = 0.0;
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (int i = 0; i < num_planes; ++i) {
+            utils::Rotation rotation = static_cast<utils::Rotation>(utils::Random::randInt() % static_cast<int>(utils::Rotation::kRotateSize));
+            if (rotation_method == "calculate") {
+                for (int pos = 0; pos < board_area; ++pos) { rotated_plane[pos] = plane[utils::calculatePositionByRotating(rotation, pos, board_size)]; }
+            } else {
+                utils::rotatePlane(plane.data(), rotated_plane.data(), rotation, board_size);
+            }
+            checksum += rotated_plane[i % board_area];
+        }
+        double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        report("feature_rotation", {{"board_size", std::to_string(board_size)},
+                                    {"rotation", rotation_method},
+                                    {"planes", std::to_string(num_planes)},
+                                    {"ns/plane", std::to_string(elapsed_us * 1000 / num_planes)},
+                                    {"checksum", std::to_string(checksum)}});
+    }
+}
+
+void Benchmark::cmdZeroServerIngestion(const std::vector<std::string>& args)
+{
+    // format: zero_server_ingestion [max_num_workers] [num_games_per_worker] [max_game_length]
+    // measures the self-play games received per second by the zero server from 1, 2, 4, ..., max_num_workers local stand-in workers
+    const int max_num_workers = getArgument(args, 1, 64);
+    const int num_games_per_worker = getArgument(args, 2, 200);
+    const int max_game_length = getArgument(args, 3, 200);
+
+    std::vector<EnvironmentLoader> env_loaders = createRandomGames(20, max_game_length, 32);
+    for (const std::string protocol : {"text", "text_gzip", "binary", "binary_gzip"}) {
+        // encode the games as the actors do, see ThreadSharedData::outputGame
+        std::vector<std::string> games;
+        size_t num_bytes = 0;
+        for (const auto& env_loader : env_loaders) {
+            const int game_length = env_loader.getActionPairs().size();
+            if (protocol == "text" || protocol == "text_gzip") {
+                games.push_back("SelfPlay true " + std::to_string(game_length) + " " + std::to_string(game_length) + " 0 " + env_loader.toString() + " #");
+                games.back() = (protocol == "text" ? games.back() : "SelfPlayGzip " + utils::compressString(games.back())) + "\n";
+            } else {
+                games.push_back(utils::toWireSelfPlayPayload(true, game_length, game_length, 0.0f, env_loader.toString()));
+                games.back() = utils::toWireFrame(protocol == "binary" ? games.back() : utils::compressWireSelfPlayPayload(games.back()));
+            }
+            num_bytes += games.back().size();
+        }
+
+        for (int num_workers = 1; num_workers <= max_num_workers; num_workers *= 2) {
+            // the server listens on an ephemeral port, so that the benchmark never binds the port of a running zero server
+            const int zero_server_port = config::zero_server_port;
+            config::zero_server_port = 0;
+            BenchmarkZeroServer server;
+            config::zero_server_port = zero_server_port;
+            server.startAccept();
+
+            // each worker connects, introduces itself as a self-play worker, and sends its games as fast as possible
+            const int port = server.getPort();
+            std::mutex error_mutex;
+            std::vector<std::string> errors;
+            boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+            boost::thread_group workers;
+            for (int id = 0; id < num_workers; ++id) {
+                workers.create_thread([id, port, num_games_per_worker, &games, &error_mutex, &errors]() {
+                    try {
+                        boost::asio::io_service io_service;
+                        boost::asio::ip::tcp::socket socket(io_service);
+                        socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+                        boost::asio::write(socket, boost::asio::buffer("Info benchmark_worker_" + std::to_string(id) + " sp binary\n"));
+                        for (int i = 0; i < num_games_per_worker; ++i) { boost::asio::write(socket, boost::asio::buffer(games[(id + i) % games.size()])); }
+
+                        // close gracefully after the server has read everything, since closing with unread job commands resets the connection
+                        socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+                        boost::system::error_code error;
+                        boost::asio::streambuf server_messages;
+                        boost::asio::read(socket, server_messages, error);
+                    } catch (const std::exception& e) {
+                        std::lock_guard lock(error_mutex);
+                        errors.push_back("benchmark_worker_" + std::to_string(id) + ": " + e.what());
+                    }
+                });
+            }
+
+            // a worker that failed to connect or a game that the server dropped would otherwise block the benchmark forever
+            const int timeout_ms = 10000;
+            const int num_games = num_workers * num_games_per_worker;
+            int num_received_games = 0;
+            zero::ZeroSelfPlayData sp_data;
+            while (num_received_games < num_games && server.waitSelfPlayData(sp_data, timeout_ms)) { ++num_received_games; }
+            double elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+            workers.join_all();
+            server.shutdown();
+
+            if (num_received_games < num_games) {
+                std::cerr << "zero_server_ingestion failed with " << protocol << " protocol and " << num_workers << " workers: received " << num_received_games << " of " << num_games << " games before timeout" << std::endl;
+                for (const auto& error : errors) { std::cerr << "\t" << error << std::endl; }
+                return;
+            }
+
+            report("zero_server_ingestion", {{"protocol", protocol},
+                                             {"io_threads", std::to_string(config::zero_server_num_io_threads)},
+                                             {"parse_threads", std::to_string(config::zero_server_num_parse_threads)},
+                                             {"workers", std::to_string(num_workers)},
+                                             {"games", std::to_string(num_games)},
+                                             {"KB/game", std::to_string(num_bytes / 1024.0 / games.size())},
+                                             {"games/sec", std::to_string(num_games / (elapsed_us / 1e6))}});
+        }
+    }
+}
+
+void Benchmark::cmdSelfPlayPersistence(const std::vector<std::string>& args)
+{
+    // format: self_play_persistence [num_games] [max_game_length]
+    // compares the time that the zero server spends on saving each self-play game (sgf and binary records) when writing on its own thread or on a writer thread
+    const int num_games = getArgument(args, 1, 1000);
+    const int max_game_length = getArgument(args, 2, 200);
+
+    std::vector<std::string> records;
+    for (const auto& env_loader : createRandomGames(20, max_game_length, 32)) { records.push_back(env_loader.toString() + " #"); }
+    for (const std::string mode : {"inline", "async", "async_gzip"}) {
+        const std::string file_name_prefix = "benchmark_self_play_" + mode;
+        const std::string sgf_file_name = file_name_prefix + (mode == "async_gzip" ? ".sgf.gz" : ".sgf");
+        zero::ZeroSelfPlayWriter self_play_writer;
+        std::ofstream sgf_file;
+        utils::RecordFileWriter record_file;
+        if (mode == "inline") {
+            sgf_file.open(sgf_file_name);
+            record_file.open(file_name_prefix + ".bin");
+        } else {
+            self_play_writer.open(file_name_prefix, mode == "async_gzip", true);
+        }
+
+        // the server thread only hands each game over in the async modes, and the writer thread finishes all games when closing
+        boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+        for (int i = 0; i < num_games; ++i) {
+            std::string record = records[i % records.size()];
+            if (mode == "inline") {
+                sgf_file << record << std::endl;
+                EnvironmentLoader env_loader;
+                if (env_loader.loadFromString(record.substr(0, record.size() - 2))) { record_file.write(env_loader.toBinaryString()); }
+            } else {
+                self_play_writer.write(std::move(record));
+            }
+        }
+        double server_elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+        sgf_file.close();
+        record_file.close();
+        self_play_writer.close();
+        double total_elapsed_us = (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+        std::ifstream saved_sgf_file(sgf_file_name, std::ios::binary | std::ios::ate);
+        report("self_play_persistence", {{"mode", mode},
+                                         {"games", std::to_string(num_games)},
+                                         {"sgf KB/game", std::to_string(saved_sgf_file.tellg() / 1024.0 / num_games)},
+                                         {"server us/game", std::to_string(server_elapsed_us / num_games)},
+                                         {"total us/game", std::to_string(total_elapsed_us / num_games)}});
+        std::remove(sgf_file_name.c_str());
+        std::remove((file_name_prefix + ".bin").c_str());
+    }
+}
+
+int Benchmark::getArgument(const std::vector<std::string>& args, size_t index, int default_value) const
+{
+    return (index < args.size() ? std::stoi(args[index]) : default_value);
+}
+
+void Benchmark::report(const std::string& name, const std::vector<std::pair<std::string, std::string>>& results)
+{
+    std::ostringstream oss;
+    oss << "[" << name << "]";
+    for (const auto& result : results) { oss << " " << result.first << ": " << result.second << ","; }
+    std::string report_string = oss.str();
+    report_string.pop_back();
+    std::cout << report_string << std::endl;
+}
+
+} // namespace minizero::console
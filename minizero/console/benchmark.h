@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace minizero::console {
+
+class Benchmark {
+public:
+    Benchmark();
+    virtual ~Benchmark() = default;
+
+    virtual void executeCommand(std::string command);
+
+protected:
+    class BaseFunction {
+    public:
+        virtual ~BaseFunction() = default;
+        virtual void operator()(const std::vector<std::string>& args) = 0;
+    };
+
+    template <class I, class F>
+    class Function : public BaseFunction {
+    public:
+        Function(I* instance, F function) : instance_(instance), function_(function) {}
+        void operator()(const std::vector<std::string>& args) { (*instance_.*function_)(args); }
+
+        I* instance_;
+        F function_;
+    };
+
+    template <class I, class F>
+    void RegisterFunction(const std::string& name, I* instance, F function)
+    {
+        function_map_[name] = std::make_shared<Function<I, F>>(instance, function);
+    }
+
+    void cmdListBenchmarks(const std::vector<std::string>& args);
+    void cmdMCTSSelection(const std::vector<std::string>& args);
+    void cmdSelfPlayThroughput(const std::vector<std::string>& args);
+    void cmdEnvTransition(const std::vector<std::string>& args);
+    void cmdNetworkOutputUnpacking(const std::vector<std::string>& args);
+    void cmdActorDispatch(const std::vector<std::string>& args);
+    void cmdReplayBufferLoading(const std::vector<std::string>& args);
+    void cmdFeatureSampling(const std::vector<std::string>& args);
+    void cmdMuZeroUnrolling(const std::vector<std::string>& args);
+    void cmdFeatureRotation(const std::vector<std::string>& args);
+    void cmdZeroServerIngestion(const std::vector<std::string>& args);
+    void cmdSelfPlayPersistence(const std::vector<std::string>& args);
+
+    int getArgument(const std::vector<std::string>& args, size_t index, int default_value) const;
+    void report(const std::string& name, const std::vector<std::pair<std::string, std::string>>& results);
+
+    std::map<std::string, std::shared_ptr<BaseFunction>> function_map_;
+};
+
+} // namespace minizero::console
@@ -1,5 +1,6 @@
 #include "mode_handler.h"
 #include "actor_group.h"
+#include "benchmark.h"
 #include "console.h"
 #include "git_info.h"
 #include "obs_recover.h"
@@ -17,6 +18,7 @@ using namespace minizero::utils;
 ModeHandler::ModeHandler()
 {
     RegisterFunction("console", this, &ModeHandler::runConsole);
+    RegisterFunction("benchmark", this, &ModeHandler::runBenchmark);
     RegisterFunction("sp", this, &ModeHandler::runSelfPlay);
     RegisterFunction("zero_server", this, &ModeHandler::runZeroServer);
     RegisterFunction("zero_training_name", this, &ModeHandler::runZeroTrainingName);
@@ -140,6 +142,17 @@ void ModeHandler::runConsole()
     }
 }
 
+void ModeHandler::runBenchmark()
+{
+    console::Benchmark benchmark;
+    std::string command;
+    std::cerr << "Successfully started benchmark mode" << std::endl;
+    while (getline(std::cin, command)) {
+        if (command == "quit") { break; }
+        benchmark.executeCommand(command);
+    }
+}
+
 void ModeHandler::runSelfPlay()
 {
     actor::ActorGroup ag;
@@ -175,12 +175,22 @@ void AtariEnvLoader::reset()
 {
     BaseEnvLoader::reset();
     observations_.clear();
+    lives_.clear();
 }
 
 bool AtariEnvLoader::loadFromString(const std::string& content)
 {
     bool success = BaseEnvLoader::loadFromString(content);
     addObservations(getTag("OBS"));
+    addLives();
+    return success;
+}
+
+bool AtariEnvLoader::loadFromBinary(const char* data, size_t size)
+{
+    bool success = BaseEnvLoader::loadFromBinary(data, size);
+    addObservations(getTag("OBS"));
+    addLives();
     return success;
 }
 
@@ -194,6 +204,7 @@ void AtariEnvLoader::loadFromEnvironment(const AtariEnv& env, const std::vector<
         if (lives < previous_lives) { action_pairs_[i].second["L"] = std::to_string(lives); }
         previous_lives = lives;
     }
+    addLives();
 }
 
 std::vector<float> AtariEnvLoader::getFeatures(const int pos, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
@@ -222,18 +233,19 @@ std::vector<float> AtariEnvLoader::getFeatures(const int pos, utils::Rotation ro
 
 std::vector<float> AtariEnvLoader::getActionFeatures(const int pos, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
 {
-    int hidden_size = kAtariHiddenChannelHeight * kAtariHiddenChannelWidth;
-    std::vector<float> action_features(kAtariActionSize * hidden_size, 0.0f);
-    if (pos < static_cast<int>(action_pairs_.size())) {
-        const AtariAction& action = action_pairs_[pos].first;
-        std::fill(action_features.begin() + action.getActionID() * hidden_size, action_features.begin() + (action.getActionID() + 1) * hidden_size, 1.0f);
-    } else {
-        int action_id = utils::Random::randInt() % kAtariActionSize;
-        std::fill(action_features.begin() + action_id * hidden_size, action_features.begin() + (action_id + 1) * hidden_size, 1.0f);
-    }
+    std::vector<float> action_features(kAtariActionSize * kAtariHiddenChannelHeight * kAtariHiddenChannelWidth);
+    writeActionFeatures(pos, action_features.data(), rotation);
     return action_features;
 }
 
+void AtariEnvLoader::writeActionFeatures(const int pos, float* action_features, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
+{
+    int hidden_size = kAtariHiddenChannelHeight * kAtariHiddenChannelWidth;
+    int action_id = (pos < static_cast<int>(action_pairs_.size()) ? action_pairs_[pos].first.getActionID() : utils::Random::randInt() % kAtariActionSize);
+    std::fill(action_features, action_features + kAtariActionSize * hidden_size, 0.0f);
+    std::fill(action_features + action_id * hidden_size, action_features + (action_id + 1) * hidden_size, 1.0f);
+}
+
 void AtariEnvLoader::addObservations(const std::string& compressed_obs)
 {
     observations_.resize(action_pairs_.size() + 1, "");
@@ -248,6 +260,13 @@ void AtariEnvLoader::addObservations(const std::string& compressed_obs)
     assert(index >= 0);
 }
 
+void AtariEnvLoader::addLives()
+{
+    // parse the L tags once, so that calculating n-step values never parses strings
+    lives_.resize(action_pairs_.size());
+    for (size_t i = 0; i < action_pairs_.size(); ++i) { lives_[i] = (action_pairs_[i].second.count("L") ? std::stoi(action_pairs_[i].second.at("L")) : -1); }
+}
+
 std::vector<float> AtariEnvLoader::getFeaturesByReplay(const int pos, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
 {
     AtariEnv env;
@@ -266,19 +285,19 @@ float AtariEnvLoader::calculateNStepValue(const int pos) const
     const float discount = config::actor_mcts_reward_discount;
     size_t bootstrap_index = pos + n_step;
     float value = 0.0f;
-    float n_step_value = ((bootstrap_index < action_pairs_.size() && !action_pairs_[bootstrap_index].second.count("L")) ? std::pow(discount, n_step) * BaseEnvLoader::getValue(bootstrap_index)[0] : 0.0f);
+    float n_step_value = ((bootstrap_index < action_pairs_.size() && lives_[bootstrap_index] < 0) ? std::pow(discount, n_step) * values_[bootstrap_index] : 0.0f);
     for (size_t index = pos; index < std::min(bootstrap_index, action_pairs_.size()); ++index) {
-        if (action_pairs_[index].second.count("L") && std::stoi(action_pairs_[index].second.at("L")) > 0) { return value; }
-        float reward = BaseEnvLoader::getReward(index)[0];
+        if (lives_[index] > 0) { return value; }
+        float reward = rewards_[index];
         value += std::pow(discount, index - pos) * reward;
     }
     value += n_step_value;
     return value;
 }
 
-std::vector<float> AtariEnvLoader::toDiscreteValue(float value) const
+void AtariEnvLoader::toDiscreteValue(float value, float* discrete_value) const
 {
-    std::vector<float> discrete_value(kAtariDiscreteValueSize, 0.0f);
+    std::fill(discrete_value, discrete_value + kAtariDiscreteValueSize, 0.0f);
     int value_floor = floor(value);
     int value_ceil = ceil(value);
     int shift = kAtariDiscreteValueSize / 2;
@@ -290,7 +309,6 @@ std::vector<float> AtariEnvLoader::toDiscreteValue(float value) const
         discrete_value[value_floor_shift] = value_ceil - value;
         discrete_value[value_ceil_shift] = value - value_floor;
     }
-    return discrete_value;
 }
 
 } // namespace minizero::env::atari
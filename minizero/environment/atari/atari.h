@@ -101,12 +101,26 @@ class AtariEnvLoader : public BaseEnvLoader<AtariAction, AtariEnv> {
 public:
     void reset() override;
     bool loadFromString(const std::string& content) override;
+    bool loadFromBinary(const char* data, size_t size) override;
     void loadFromEnvironment(const AtariEnv& env, const std::vector<std::vector<std::pair<std::string, std::string>>>& action_info_history = {}) override;
     std::vector<float> getFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
-    std::vector<float> getValue(const int pos) const override { return toDiscreteValue(pos < static_cast<int>(action_pairs_.size()) ? utils::transformValue(calculateNStepValue(pos)) : 0.0f); }
-    inline std::vector<float> getReward(const int pos) const override { return toDiscreteValue(pos < static_cast<int>(action_pairs_.size()) ? utils::transformValue(BaseEnvLoader::getReward(pos)[0]) : 0.0f); }
-    float getPriority(const int pos) const override { return fabs(calculateNStepValue(pos) - BaseEnvLoader::getValue(pos)[0]) + 1e-6; }
+    void writeActionFeatures(const int pos, float* action_features, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    std::vector<float> getValue(const int pos) const override
+    {
+        std::vector<float> value(kAtariDiscreteValueSize);
+        writeValue(pos, value.data());
+        return value;
+    }
+    void writeValue(const int pos, float* value) const override { toDiscreteValue(pos < static_cast<int>(action_pairs_.size()) ? utils::transformValue(calculateNStepValue(pos)) : 0.0f, value); }
+    std::vector<float> getReward(const int pos) const override
+    {
+        std::vector<float> reward(kAtariDiscreteValueSize);
+        writeReward(pos, reward.data());
+        return reward;
+    }
+    void writeReward(const int pos, float* reward) const override { toDiscreteValue(pos < static_cast<int>(action_pairs_.size()) ? utils::transformValue(rewards_[pos]) : 0.0f, reward); }
+    float getPriority(const int pos) const override { return fabs(calculateNStepValue(pos) - values_[pos]) + 1e-6; }
 
     inline std::string name() const override { return kAtariName + "_" + minizero::config::env_atari_name; }
     inline int getPolicySize() const override { return kAtariActionSize; }
@@ -115,11 +129,13 @@ public:
 
 private:
     void addObservations(const std::string& compressed_obs);
+    void addLives();
     std::vector<float> getFeaturesByReplay(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const;
     float calculateNStepValue(const int pos) const;
-    std::vector<float> toDiscreteValue(float value) const;
+    void toDiscreteValue(float value, float* discrete_value) const;
 
     std::vector<std::string> observations_;
+    std::vector<int> lives_; // the remaining lives after losing a life at each position, -1 if no life is lost
 };
 
 } // namespace minizero::env::atari
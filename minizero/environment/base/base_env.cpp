@@ -1,4 +1,5 @@
 #include "base_env.h"
+#include <random>
 
 namespace minizero::env {
 
@@ -41,4 +42,34 @@ Player getPreviousPlayer(Player player, int num_player)
     return Player::kPlayerNone;
 }
 
+class ZobristHashKeyTable {
+public:
+    ZobristHashKeyTable()
+    {
+        std::mt19937_64 generator;
+        generator.seed(0);
+        for (auto& key : turn_keys_) { key = generator(); }
+        for (auto& keys : position_keys_) {
+            for (auto& key : keys) { key = generator(); }
+        }
+    }
+
+    static const int kMaxNumPositions = 32 * 32;
+    uint64_t turn_keys_[static_cast<int>(Player::kPlayerSize)];
+    uint64_t position_keys_[kMaxNumPositions][static_cast<int>(Player::kPlayerSize)];
+};
+
+const ZobristHashKeyTable zobrist_hash_key_table;
+
+uint64_t getZobristHashKey(int position, Player player)
+{
+    assert(position >= 0 && position < ZobristHashKeyTable::kMaxNumPositions);
+    return zobrist_hash_key_table.position_keys_[position][static_cast<int>(player)];
+}
+
+uint64_t getZobristTurnHashKey(Player player)
+{
+    return zobrist_hash_key_table.turn_keys_[static_cast<int>(player)];
+}
+
 } // namespace minizero::env
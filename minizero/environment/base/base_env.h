@@ -1,16 +1,19 @@
 #pragma once
 
 #include "configuration.h"
+#include "record_file.h"
 #include "rotation.h"
 #include "sgf_loader.h"
 #include "utils.h"
 #include "vector_map.h"
 #include <algorithm>
 #include <cassert>
+#include <cstdint>
 #include <fstream>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -30,6 +33,8 @@ char playerToChar(Player p);
 Player charToPlayer(char c);
 Player getNextPlayer(Player player, int num_player);
 Player getPreviousPlayer(Player player, int num_player);
+uint64_t getZobristHashKey(int position, Player player);
+uint64_t getZobristTurnHashKey(Player player);
 
 class BaseAction {
 public:
@@ -86,6 +91,7 @@ public:
     virtual float getEvalScore(bool is_resign = false) const = 0;
     virtual std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const = 0;
     virtual std::vector<float> getActionFeatures(const Action& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const = 0;
+    virtual uint64_t getFeatureHashKey() const { return 0; } // identifies getFeatures() without rotation; 0 represents not supported
     virtual int getNumInputChannels() const = 0;
     virtual int getNumActionFeatureChannels() const = 0;
     virtual int getInputChannelHeight() const = 0;
@@ -114,7 +120,7 @@ protected:
 template <class Action, class Env>
 class BaseEnvLoader {
 public:
-    BaseEnvLoader() {}
+    BaseEnvLoader() : column_info_only_(false), policy_offsets_(1, 0) {}
     virtual ~BaseEnvLoader() = default;
 
     typedef minizero::utils::VectorMap<std::string, std::string> Tags;
@@ -123,11 +129,13 @@ public:
 public:
     virtual void reset()
     {
+        column_info_only_ = false;
         sgf_content_.clear();
         tags_.clear();
         tags_.insert({"GM", name()});
         tags_.insert({"RE", "0"});
         action_pairs_.clear();
+        buildColumns();
     }
 
     virtual bool loadFromFile(const std::string& file_name)
@@ -199,9 +207,100 @@ public:
                     break;
             }
         }
+        buildColumns();
         return state == ')';
     }
 
+    // binary record: tags, then columns of action ids, players, values, rewards, and the sparse policy, then the remaining action info
+    // P, V, and R are only stored in the columns, so loadFromBinary() does not restore them as strings in getActionPairs(); read them by getActionInfo() instead
+    virtual std::string toBinaryString() const
+    {
+        utils::RecordBuilder builder;
+        builder.write(static_cast<uint32_t>(tags_.size()));
+        for (const auto& t : tags_) {
+            builder.writeString(t.first);
+            builder.writeString(t.second);
+        }
+
+        const int num_actions = action_pairs_.size();
+        std::vector<int32_t> action_ids(num_actions);
+        std::vector<uint8_t> players(num_actions);
+        for (int i = 0; i < num_actions; ++i) {
+            action_ids[i] = action_pairs_[i].first.getActionID();
+            players[i] = static_cast<uint8_t>(action_pairs_[i].first.getPlayer());
+        }
+        builder.write(static_cast<uint32_t>(num_actions));
+        builder.write(action_ids.data(), action_ids.size());
+        builder.write(players.data(), players.size());
+        builder.write(values_.data(), values_.size());
+        builder.write(rewards_.data(), rewards_.size());
+        builder.write(policy_offsets_.data(), policy_offsets_.size());
+        builder.write(policy_ids_.data(), policy_ids_.size());
+        builder.write(policy_counts_.data(), policy_counts_.size());
+
+        std::vector<std::tuple<int32_t, std::string, std::string>> action_infos;
+        for (int i = 0; i < num_actions; ++i) {
+            for (const auto& info : action_pairs_[i].second) {
+                if (!isColumnInfo(info.first)) { action_infos.emplace_back(i, info.first, info.second); }
+            }
+        }
+        builder.write(static_cast<uint32_t>(action_infos.size()));
+        for (const auto& info : action_infos) {
+            builder.write(std::get<0>(info));
+            builder.writeString(std::get<1>(info));
+            builder.writeString(std::get<2>(info));
+        }
+        return builder.getRecord();
+    }
+
+    // the action info stored in columns is not kept as strings, which saves the memory of the replay buffer
+    virtual bool loadFromBinary(const char* data, size_t size)
+    {
+        reset();
+        column_info_only_ = true;
+        utils::RecordParser parser(data, size);
+        uint32_t num_tags = 0;
+        if (!parser.read(num_tags)) { return false; }
+        for (uint32_t i = 0; i < num_tags; ++i) {
+            std::string key, value;
+            if (!parser.readString(key) || !parser.readString(value)) { return false; }
+            tags_[key] = std::move(value);
+        }
+
+        uint32_t num_actions = 0;
+        if (!parser.read(num_actions) || num_actions > size) { return false; }
+        std::vector<int32_t> action_ids(num_actions);
+        std::vector<uint8_t> players(num_actions);
+        values_.resize(num_actions);
+        rewards_.resize(num_actions);
+        policy_offsets_.resize(num_actions + 1);
+        if (!parser.read(action_ids.data(), num_actions) || !parser.read(players.data(), num_actions) ||
+            !parser.read(values_.data(), num_actions) || !parser.read(rewards_.data(), num_actions) ||
+            !parser.read(policy_offsets_.data(), num_actions + 1)) {
+            return false;
+        }
+        const int32_t num_policy_entries = policy_offsets_.back();
+        if (policy_offsets_[0] != 0 || num_policy_entries < 0 || static_cast<size_t>(num_policy_entries) > size) { return false; }
+        for (uint32_t i = 0; i < num_actions; ++i) {
+            if (policy_offsets_[i] > policy_offsets_[i + 1]) { return false; }
+        }
+        policy_ids_.resize(num_policy_entries);
+        policy_counts_.resize(num_policy_entries);
+        if (!parser.read(policy_ids_.data(), num_policy_entries) || !parser.read(policy_counts_.data(), num_policy_entries)) { return false; }
+        action_pairs_.reserve(num_actions);
+        for (uint32_t i = 0; i < num_actions; ++i) { action_pairs_.emplace_back(Action(action_ids[i], static_cast<Player>(players[i])), ActionInfo()); }
+
+        uint32_t num_action_infos = 0;
+        if (!parser.read(num_action_infos)) { return false; }
+        for (uint32_t i = 0; i < num_action_infos; ++i) {
+            int32_t pos = 0;
+            std::string key, value;
+            if (!parser.read(pos) || !parser.readString(key) || !parser.readString(value) || pos < 0 || pos >= static_cast<int32_t>(num_actions)) { return false; }
+            action_pairs_[pos].second[key] = std::move(value);
+        }
+        return parser.isEnd();
+    }
+
     virtual void loadFromEnvironment(const Env& env, const std::vector<std::vector<std::pair<std::string, std::string>>>& action_info_history = {})
     {
         reset();
@@ -222,14 +321,17 @@ public:
         std::ostringstream oss;
         oss << "(;";
         for (const auto& t : tags_) { oss << t.first << "[" << escapeSGFString(t.second) << "]"; }
-        for (const auto& p : action_pairs_) {
-            oss << ";" << playerToChar(p.first.getPlayer()) << "[" << p.first.getActionID() << "]";
-            for (const auto& info : p.second) { oss << info.first << "[" << escapeSGFString(info.second) << "]"; }
+        for (size_t i = 0; i < action_pairs_.size(); ++i) {
+            oss << ";" << playerToChar(action_pairs_[i].first.getPlayer()) << "[" << action_pairs_[i].first.getActionID() << "]";
+            for (const auto& info : getActionInfo(i)) { oss << info.first << "[" << escapeSGFString(info.second) << "]"; }
         }
         oss << ")";
         return oss.str();
     }
 
+    // caches the board of each position so that getFeatures() does not need to replay the game, at the cost of memory
+    virtual void cacheFeatures() {}
+
     virtual std::vector<float> getFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const
     {
         // a slow but naive method which simply replays the game again to get features
@@ -240,27 +342,45 @@ public:
 
     virtual std::vector<float> getPolicy(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const
     {
-        std::vector<float> policy(getPolicySize(), 0.0f);
+        std::vector<float> policy(getPolicySize());
+        writePolicy(pos, policy.data(), rotation);
+        return policy;
+    }
+
+    // the write functions write the same data as the get functions into preallocated memory, which avoids allocating vectors when building batches
+    virtual void writePolicy(const int pos, float* policy, utils::Rotation rotation = utils::Rotation::kRotationNone) const
+    {
+        const int policy_size = getPolicySize();
         if (pos < static_cast<int>(action_pairs_.size())) {
-            const std::string policy_distribution = action_pairs_[pos].second["P"];
-            if (policy_distribution.empty()) {
+            std::fill(policy, policy + policy_size, 0.0f);
+            if (policy_offsets_[pos] == policy_offsets_[pos + 1]) {
                 policy[getRotateAction(action_pairs_[pos].first.getActionID(), rotation)] = 1.0f;
             } else {
-                std::string tmp;
                 float total = 0.0f;
-                std::istringstream iss(policy_distribution);
-                while (std::getline(iss, tmp, ',')) {
-                    int position = getRotateAction(std::stoi(tmp.substr(0, tmp.find(":"))), rotation);
-                    float count = std::stof(tmp.substr(tmp.find(":") + 1));
-                    policy[position] = count;
-                    total += count;
-                }
-                for (auto& p : policy) { p /= total; }
+                for (int i = policy_offsets_[pos]; i < policy_offsets_[pos + 1]; ++i) { total += policy_counts_[i]; }
+                for (int i = policy_offsets_[pos]; i < policy_offsets_[pos + 1]; ++i) { policy[getRotateAction(policy_ids_[i], rotation)] = policy_counts_[i] / total; }
             }
         } else { // absorbing states
-            std::fill(policy.begin(), policy.end(), 1.0f / getPolicySize());
+            std::fill(policy, policy + policy_size, 1.0f / policy_size);
         }
-        return policy;
+    }
+
+    virtual void writeActionFeatures(const int pos, float* action_features, utils::Rotation rotation = utils::Rotation::kRotationNone) const
+    {
+        const std::vector<float> features = getActionFeatures(pos, rotation);
+        std::copy(features.begin(), features.end(), action_features);
+    }
+
+    virtual void writeValue(const int pos, float* value) const
+    {
+        const std::vector<float> v = getValue(pos);
+        std::copy(v.begin(), v.end(), value);
+    }
+
+    virtual void writeReward(const int pos, float* reward) const
+    {
+        const std::vector<float> r = getReward(pos);
+        std::copy(r.begin(), r.end(), reward);
     }
 
     virtual std::pair<int, int> getDataRange() const
@@ -273,14 +393,27 @@ public:
         }
     }
 
-    virtual std::vector<float> getValue(const int pos) const { return (pos < static_cast<int>(action_pairs_.size()) ? std::vector<float>{std::stof(action_pairs_[pos].second["V"])} : std::vector<float>{0.0f}); }
-    virtual std::vector<float> getReward(const int pos) const { return (pos < static_cast<int>(action_pairs_.size()) ? std::vector<float>{std::stof(action_pairs_[pos].second["R"])} : std::vector<float>{0.0f}); }
+    virtual std::vector<float> getValue(const int pos) const { return (pos < static_cast<int>(action_pairs_.size()) ? std::vector<float>{values_[pos]} : std::vector<float>{0.0f}); }
+    virtual std::vector<float> getReward(const int pos) const { return (pos < static_cast<int>(action_pairs_.size()) ? std::vector<float>{rewards_[pos]} : std::vector<float>{0.0f}); }
     virtual bool setActionPairInfo(const int pos, const std::string& tag, const std::string value)
     {
         if (pos >= static_cast<int>(action_pairs_.size())) { return false; }
+        if (column_info_only_) { restoreColumnInfo(); } // buildColumns() below parses the strings
         action_pairs_[pos].second[tag] = value;
+        if (tag == "V") {
+            values_[pos] = std::stof(value);
+        } else if (tag == "R") {
+            rewards_[pos] = std::stof(value);
+        } else if (tag == "P") {
+            buildColumns();
+        }
         return true;
     }
+    // only updates the value column used for training, i.e., toString() still contains the original V
+    inline void setValue(const int pos, float value)
+    {
+        if (pos < static_cast<int>(values_.size())) { values_[pos] = value; }
+    }
     virtual float getPriority(const int pos) const { return 1.0f; }
 
     virtual std::vector<float> getActionFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const = 0;
@@ -294,10 +427,67 @@ public:
     inline std::string getSGFContent() const { return sgf_content_; }
     inline std::vector<std::pair<Action, ActionInfo>>& getActionPairs() { return action_pairs_; }
     inline const std::vector<std::pair<Action, ActionInfo>>& getActionPairs() const { return action_pairs_; }
-    inline void addActionPair(const Action& action, const ActionInfo& action_info = {}) { action_pairs_.emplace_back(action, action_info); }
+    // the action info of a position, where P, V, and R are formatted from the columns if they are not kept as strings
+    ActionInfo getActionInfo(const int pos) const
+    {
+        if (!column_info_only_) { return action_pairs_[pos].second; }
+        ActionInfo action_info;
+        std::ostringstream policy, reward;
+        for (int i = policy_offsets_[pos]; i < policy_offsets_[pos + 1]; ++i) { policy << (i == policy_offsets_[pos] ? "" : ",") << policy_ids_[i] << ":" << policy_counts_[i]; }
+        reward << rewards_[pos];
+        if (policy_offsets_[pos] < policy_offsets_[pos + 1]) { action_info["P"] = policy.str(); }
+        action_info["V"] = std::to_string(values_[pos]);
+        action_info["R"] = reward.str();
+        for (const auto& info : action_pairs_[pos].second) {
+            if (!isColumnInfo(info.first)) { action_info[info.first] = info.second; }
+        }
+        return action_info;
+    }
+    inline void addActionPair(const Action& action, const ActionInfo& action_info = {})
+    {
+        action_pairs_.emplace_back(action, action_info);
+        addColumns(action_pairs_.back().second);
+    }
     inline float getReturn() const { return std::stof(getTag("RE")); }
 
 protected:
+    // parses the policy, value, and reward of each position once, so that sampling training data never parses strings
+    // should be called again after modifying the action info of action_pairs_ directly
+    void buildColumns()
+    {
+        values_.clear();
+        rewards_.clear();
+        policy_offsets_.assign(1, 0);
+        policy_ids_.clear();
+        policy_counts_.clear();
+        for (const auto& p : action_pairs_) { addColumns(p.second); }
+    }
+
+    void addColumns(const ActionInfo& action_info)
+    {
+        const std::string& value = action_info["V"];
+        const std::string& reward = action_info["R"];
+        values_.push_back(value.empty() ? 0.0f : std::stof(value));
+        rewards_.push_back(reward.empty() ? 0.0f : std::stof(reward));
+
+        // format: action_id:count,action_id:count,...
+        std::string tmp;
+        std::istringstream iss(action_info["P"]);
+        while (std::getline(iss, tmp, ',')) {
+            policy_ids_.push_back(std::stoi(tmp.substr(0, tmp.find(":"))));
+            policy_counts_.push_back(std::stof(tmp.substr(tmp.find(":") + 1)));
+        }
+        policy_offsets_.push_back(policy_ids_.size());
+    }
+
+    inline bool isColumnInfo(const std::string& key) const { return (key == "P" || key == "V" || key == "R"); }
+
+    void restoreColumnInfo()
+    {
+        for (size_t i = 0; i < action_pairs_.size(); ++i) { action_pairs_[i].second = getActionInfo(i); }
+        column_info_only_ = false;
+    }
+
     std::string escapeSGFString(const std::string& str) const
     {
         std::string special = "()[]\\";
@@ -311,9 +501,15 @@ protected:
     }
 
 protected:
+    bool column_info_only_; // P, V, and R are only stored in the columns, i.e., loaded by loadFromBinary()
     std::string sgf_content_;
     Tags tags_;
     std::vector<std::pair<Action, ActionInfo>> action_pairs_;
+    std::vector<float> values_;
+    std::vector<float> rewards_;
+    std::vector<int32_t> policy_offsets_; // the policy of position i is in [policy_offsets_[i], policy_offsets_[i + 1])
+    std::vector<int32_t> policy_ids_;
+    std::vector<float> policy_counts_;
 };
 
 template <int kNumPlayer = 2>
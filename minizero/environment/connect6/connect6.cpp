@@ -141,16 +141,14 @@ std::vector<float> Connect6Env::getFeatures(utils::Rotation rotation /*= utils::
     int spatial = board_size_ * board_size_;
     std::vector<float> features(getNumInputChannels() * spatial, 0.f);
     int last_idx = bitboard_history_.size() - 1;
+    const utils::Rotation reversed_rotation = utils::reversed_rotation[static_cast<int>(rotation)];
 
     // 0 ~ 15
     for (int c = 0; c < 2 * past_moves; c += 2) {
         const Connect6Bitboard& own_bitboard = bitboard_history_[last_idx - (c / 2)].get(turn_);
         const Connect6Bitboard& opponent_bitboard = bitboard_history_[last_idx - (c / 2)].get(getNextPlayer(turn_, kConnect6NumPlayer));
-        for (int pos = 0; pos < spatial; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            features[pos + c * spatial] = (own_bitboard.test(rotation_pos) ? 1.0f : 0.0f);
-            features[pos + (c + 1) * spatial] = (opponent_bitboard.test(rotation_pos) ? 1.0f : 0.0f);
-        }
+        utils::writeRotatedPlane(&features[c * spatial], reversed_rotation, board_size_, [&own_bitboard](int pos) { return (own_bitboard.test(pos) ? 1.0f : 0.0f); });
+        utils::writeRotatedPlane(&features[(c + 1) * spatial], reversed_rotation, board_size_, [&opponent_bitboard](int pos) { return (opponent_bitboard.test(pos) ? 1.0f : 0.0f); });
     }
 
     // 16 ~ 19
@@ -159,13 +157,10 @@ std::vector<float> Connect6Env::getFeatures(utils::Rotation rotation /*= utils::
     Connect6Bitboard space3 = scanThreadSpace(getNextPlayer(turn_, kConnect6NumPlayer), 5);
     Connect6Bitboard space4 = scanThreadSpace(getNextPlayer(turn_, kConnect6NumPlayer), 4);
 
-    for (int pos = 0; pos < spatial; ++pos) {
-        int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-        features[pos + 16 * spatial] = (space1.test(rotation_pos) ? 1.0f : 0.0f);
-        features[pos + 17 * spatial] = (space2.test(rotation_pos) ? 1.0f : 0.0f);
-        features[pos + 18 * spatial] = (space3.test(rotation_pos) ? 1.0f : 0.0f);
-        features[pos + 19 * spatial] = (space4.test(rotation_pos) ? 1.0f : 0.0f);
-    }
+    utils::writeRotatedPlane(&features[16 * spatial], reversed_rotation, board_size_, [&space1](int pos) { return (space1.test(pos) ? 1.0f : 0.0f); });
+    utils::writeRotatedPlane(&features[17 * spatial], reversed_rotation, board_size_, [&space2](int pos) { return (space2.test(pos) ? 1.0f : 0.0f); });
+    utils::writeRotatedPlane(&features[18 * spatial], reversed_rotation, board_size_, [&space3](int pos) { return (space3.test(pos) ? 1.0f : 0.0f); });
+    utils::writeRotatedPlane(&features[19 * spatial], reversed_rotation, board_size_, [&space4](int pos) { return (space4.test(pos) ? 1.0f : 0.0f); });
 
     // 20 ~ 23
     auto it = features.begin() + 20 * spatial;
@@ -2,6 +2,7 @@
 #include "color_message.h"
 #include "random.h"
 #include "sgf_loader.h"
+#include <algorithm>
 #include <random>
 #include <sstream>
 #include <string>
@@ -42,6 +43,28 @@ void initialize()
     }
 }
 
+std::vector<float> getGoFeatures(const std::vector<GamePair<GoBitboard>>& stone_bitboard_history, int history_size, Player turn, int board_size, utils::Rotation rotation)
+{
+    /* 18 channels:
+        0~15. own/opponent position for last 8 turns
+        16. black turn
+        17. white turn
+    */
+    const int board_area = board_size * board_size;
+    const Player opponent = getNextPlayer(turn, kGoNumPlayer);
+    std::vector<float> features(18 * board_area, 0.0f);
+    const utils::Rotation reversed_rotation = utils::reversed_rotation[static_cast<int>(rotation)];
+    for (int last_n = 0; last_n < 8 && last_n < history_size; ++last_n) {
+        const GoBitboard& own_bitboard = stone_bitboard_history[history_size - 1 - last_n].get(turn);
+        const GoBitboard& opponent_bitboard = stone_bitboard_history[history_size - 1 - last_n].get(opponent);
+        utils::writeRotatedPlane(&features[(2 * last_n) * board_area], reversed_rotation, board_size, [&own_bitboard](int pos) { return (own_bitboard.test(pos) ? 1.0f : 0.0f); });
+        utils::writeRotatedPlane(&features[(2 * last_n + 1) * board_area], reversed_rotation, board_size, [&opponent_bitboard](int pos) { return (opponent_bitboard.test(pos) ? 1.0f : 0.0f); });
+    }
+    std::fill(features.begin() + 16 * board_area, features.begin() + 17 * board_area, (turn == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features.begin() + 17 * board_area, features.end(), (turn == Player::kPlayer2 ? 1.0f : 0.0f));
+    return features;
+}
+
 GoHashKey getGoTurnHashKey()
 {
     assert(config::env_go_ko_rule == "positional" || config::env_go_ko_rule == "situational");
@@ -279,32 +302,18 @@ float GoEnv::getEvalScore(bool is_resign /*= false*/) const
 
 std::vector<float> GoEnv::getFeatures(utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
 {
-    /* 18 channels:
-        0~15. own/opponent position for last 8 turns
-        16. black turn
-        17. white turn
-    */
-    std::vector<float> vFeatures;
-    for (int channel = 0; channel < 18; ++channel) {
-        for (int pos = 0; pos < board_size_ * board_size_; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel < 16) {
-                int last_n_turn = stone_bitboard_history_.size() - 1 - channel / 2;
-                if (last_n_turn < 0) {
-                    vFeatures.push_back(0.0f);
-                } else {
-                    const GamePair<GoBitboard>& last_n_trun_stone_bitboard = stone_bitboard_history_[last_n_turn];
-                    Player player = (channel % 2 == 0 ? turn_ : getNextPlayer(turn_, kGoNumPlayer));
-                    vFeatures.push_back(last_n_trun_stone_bitboard.get(player).test(rotation_pos) ? 1.0f : 0.0f);
-                }
-            } else if (channel == 16) {
-                vFeatures.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 17) {
-                vFeatures.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
-        }
+    return getGoFeatures(stone_bitboard_history_, stone_bitboard_history_.size(), turn_, board_size_, rotation);
+}
+
+uint64_t GoEnv::getFeatureHashKey() const
+{
+    // the features consist of the turn and the stones of the last 8 turns
+    uint64_t key = getZobristTurnHashKey(turn_);
+    for (int i = 1; i <= 8; ++i) {
+        int last_n_turn = hashkey_history_.size() - i;
+        key = (key ^ (last_n_turn < 0 ? 0 : hashkey_history_[last_n_turn])) * 0x9E3779B97F4A7C15ULL;
     }
-    return vFeatures;
+    return key;
 }
 
 std::vector<float> GoEnv::getActionFeatures(const GoAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
@@ -735,4 +744,37 @@ std::vector<float> GoEnvLoader::getActionFeatures(const int pos, utils::Rotation
     return action_features;
 }
 
+void GoEnvLoader::reset()
+{
+    BaseBoardEnvLoader::reset();
+    turns_.clear();
+    stone_bitboard_history_.clear();
+}
+
+void GoEnvLoader::cacheFeatures()
+{
+    // replay the game once and keep the stones after each action
+    turns_.clear();
+    stone_bitboard_history_.clear();
+    GoEnv env;
+    turns_.push_back(env.getTurn());
+    for (const auto& action_pair : action_pairs_) {
+        if (!env.act(action_pair.first)) { // keep replaying the game for games with illegal actions
+            turns_.clear();
+            stone_bitboard_history_.clear();
+            return;
+        }
+        turns_.push_back(env.getTurn());
+        stone_bitboard_history_.push_back(env.getStoneBitboard());
+    }
+}
+
+std::vector<float> GoEnvLoader::getFeatures(const int pos, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
+{
+    if (turns_.empty()) { return BaseBoardEnvLoader::getFeatures(pos, rotation); }
+
+    const int history_size = std::min(pos, static_cast<int>(action_pairs_.size()));
+    return getGoFeatures(stone_bitboard_history_, history_size, turns_[history_size], config::env_board_size, rotation);
+}
+
 } // namespace minizero::env::go
@@ -20,6 +20,7 @@ extern std::vector<GamePair<GoHashKey>> grids_hash_key;
 extern std::vector<std::vector<GamePair<GoHashKey>>> sequence_hash_key;
 
 void initialize();
+std::vector<float> getGoFeatures(const std::vector<GamePair<GoBitboard>>& stone_bitboard_history, int history_size, Player turn, int board_size, utils::Rotation rotation);
 GoHashKey getGoTurnHashKey();
 GoHashKey getGoEmptyHashKey(int position);
 GoHashKey getGoGridHashKey(int position, Player p);
@@ -50,6 +51,7 @@ public:
     float getReward() const override { return 0.0f; }
     float getEvalScore(bool is_resign = false) const override;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    uint64_t getFeatureHashKey() const override;
     std::vector<float> getActionFeatures(const GoAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     inline int getNumInputChannels() const override { return 18; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize() + 1; }
@@ -119,6 +121,9 @@ protected:
 
 class GoEnvLoader : public BaseBoardEnvLoader<GoAction, GoEnv> {
 public:
+    void reset() override;
+    void cacheFeatures() override;
+    std::vector<float> getFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     void loadFromEnvironment(const GoEnv& env, const std::vector<std::vector<std::pair<std::string, std::string>>>& action_info_history = {}) override
     {
         BaseBoardEnvLoader<GoAction, GoEnv>::loadFromEnvironment(env, action_info_history);
@@ -132,6 +137,10 @@ public:
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize() + 1; }
     inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
+
+private:
+    std::vector<Player> turns_;                                // the turn of each position
+    std::vector<GamePair<GoBitboard>> stone_bitboard_history_; // the stones after each action
 };
 
 } // namespace minizero::env::go
@@ -18,6 +18,7 @@ void GomokuEnv::reset()
     actions_.clear();
     board_.resize(board_size_ * board_size_);
     fill(board_.begin(), board_.end(), Player::kPlayerNone);
+    board_hash_key_ = 0;
 }
 
 bool GomokuEnv::act(const GomokuAction& action)
@@ -25,6 +26,7 @@ bool GomokuEnv::act(const GomokuAction& action)
     if (!isLegalAction(action)) { return false; }
     actions_.push_back(action);
     board_[action.getActionID()] = action.getPlayer();
+    board_hash_key_ ^= getZobristHashKey(action.getActionID(), action.getPlayer());
     turn_ = action.nextPlayer();
     winner_ = updateWinner(action);
     return true;
@@ -79,22 +81,15 @@ std::vector<float> GomokuEnv::getFeatures(utils::Rotation rotation /*= utils::Ro
         2. Black's turn
         3. White's turn
     */
-    std::vector<float> vFeatures;
-    for (int channel = 0; channel < 4; ++channel) {
-        for (int pos = 0; pos < board_size_ * board_size_; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel == 0) {
-                vFeatures.push_back((board_[rotation_pos] == turn_ ? 1.0f : 0.0f));
-            } else if (channel == 1) {
-                vFeatures.push_back((board_[rotation_pos] == getNextPlayer(turn_, kGomokuNumPlayer) ? 1.0f : 0.0f));
-            } else if (channel == 2) {
-                vFeatures.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 3) {
-                vFeatures.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
-        }
-    }
-    return vFeatures;
+    const int board_area = board_size_ * board_size_;
+    const utils::Rotation reversed_rotation = utils::reversed_rotation[static_cast<int>(rotation)];
+    const Player opponent = getNextPlayer(turn_, kGomokuNumPlayer);
+    std::vector<float> features(4 * board_area, 0.0f);
+    utils::writeRotatedPlane(&features[0], reversed_rotation, board_size_, [this](int pos) { return (board_[pos] == turn_ ? 1.0f : 0.0f); });
+    utils::writeRotatedPlane(&features[board_area], reversed_rotation, board_size_, [this, opponent](int pos) { return (board_[pos] == opponent ? 1.0f : 0.0f); });
+    std::fill(features.begin() + 2 * board_area, features.begin() + 3 * board_area, (turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features.begin() + 3 * board_area, features.end(), (turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
+    return features;
 }
 
 std::vector<float> GomokuEnv::getActionFeatures(const GomokuAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
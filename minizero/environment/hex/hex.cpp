@@ -17,6 +17,7 @@ void HexEnv::reset()
     actions_.clear();
     board_.resize(board_size_ * board_size_);
     fill(board_.begin(), board_.end(), Cell{Player::kPlayerNone, (Flag)0});
+    board_hash_key_ = 0;
 }
 
 bool HexEnv::act(const HexAction& action)
@@ -39,6 +40,7 @@ bool HexEnv::act(const HexAction& action)
             int reflected_id = reflected_row * board_size_ + reflected_col;
 
             // Clear original move
+            board_hash_key_ ^= getZobristHashKey(actions_[0].getActionID(), board_[actions_[0].getActionID()].player);
             board_[actions_[0].getActionID()].player = Player::kPlayerNone;
             board_[actions_[0].getActionID()].flags = Flag::NONE;
 
@@ -48,6 +50,7 @@ bool HexEnv::act(const HexAction& action)
 
     Cell* cc{&board_[action_id]};
     cc->player = action.getPlayer();
+    board_hash_key_ ^= getZobristHashKey(action_id, cc->player);
     if (cc->player == Player::kPlayer1) {
         if (action_id % board_size_ == 0)
             cc->flags = Flag::EDGE1_CONNECTION;
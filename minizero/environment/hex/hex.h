@@ -48,6 +48,7 @@ public:
     float getReward() const override { return 0.0f; }
     float getEvalScore(bool is_resign = false) const override;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    inline uint64_t getFeatureHashKey() const override { return board_hash_key_ ^ getZobristTurnHashKey(turn_); }
     std::vector<float> getActionFeatures(const HexAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     inline int getNumInputChannels() const override { return 4; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize(); }
@@ -66,6 +67,7 @@ private:
 
     Player winner_;
     std::vector<Cell> board_;
+    uint64_t board_hash_key_; // the Zobrist hash key of the stones on board_, which is updated incrementally by act()
 };
 
 class HexEnvLoader : public BaseBoardEnvLoader<HexAction, HexEnv> {
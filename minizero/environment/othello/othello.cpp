@@ -10,6 +10,26 @@
 namespace minizero::env::othello {
 using namespace minizero::utils;
 
+std::vector<float> getOthelloFeatures(const GamePair<OthelloBitboard>& board, Player turn, int board_size, utils::Rotation rotation)
+{
+    /* 4 channels:
+        0~1. own/opponent position
+        2. Black's turn
+        3. White's turn
+    */
+    const int board_area = board_size * board_size;
+    const Player opponent = getNextPlayer(turn, kOthelloNumPlayer);
+    std::vector<float> features(4 * board_area, 0.0f);
+    const utils::Rotation reversed_rotation = utils::reversed_rotation[static_cast<int>(rotation)];
+    const OthelloBitboard& own_bitboard = board.get(turn);
+    const OthelloBitboard& opponent_bitboard = board.get(opponent);
+    utils::writeRotatedPlane(&features[0], reversed_rotation, board_size, [&own_bitboard](int pos) { return (own_bitboard[pos] == 1 ? 1.0f : 0.0f); });
+    utils::writeRotatedPlane(&features[board_area], reversed_rotation, board_size, [&opponent_bitboard](int pos) { return (opponent_bitboard[pos] == 1 ? 1.0f : 0.0f); });
+    std::fill(features.begin() + 2 * board_area, features.begin() + 3 * board_area, (turn == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features.begin() + 3 * board_area, features.end(), (turn == Player::kPlayer2 ? 1.0f : 0.0f));
+    return features;
+}
+
 void OthelloEnv::reset()
 {
     turn_ = Player::kPlayer1;
@@ -24,6 +44,8 @@ void OthelloEnv::reset()
     board_.get(getNextPlayer(turn_, kOthelloNumPlayer)).set(init_place + board_size_, 1);
     board_.get(turn_).set(init_place, 1);
     board_.get(turn_).set(init_place + board_size_ + 1, 1);
+    board_hash_key_ = getZobristHashKey(init_place + 1, getNextPlayer(turn_, kOthelloNumPlayer)) ^ getZobristHashKey(init_place + board_size_, getNextPlayer(turn_, kOthelloNumPlayer)) ^
+                      getZobristHashKey(init_place, turn_) ^ getZobristHashKey(init_place + board_size_ + 1, turn_);
     // initial legal board for white and black
     legal_board_.get(getNextPlayer(turn_, kOthelloNumPlayer)).set(init_place - 1, 1);
     legal_board_.get(getNextPlayer(turn_, kOthelloNumPlayer)).set(init_place - board_size_, 1);
@@ -125,6 +147,10 @@ bool OthelloEnv::act(const OthelloAction& action)
 
     board_.get(player) |= flip;
     board_.get(getNextPlayer(player, kOthelloNumPlayer)) &= ~flip;
+    board_hash_key_ ^= getZobristHashKey(ID, player);
+    for (int pos = flip._Find_first(); pos < static_cast<int>(flip.size()); pos = flip._Find_next(pos)) {
+        board_hash_key_ ^= getZobristHashKey(pos, player) ^ getZobristHashKey(pos, getNextPlayer(player, kOthelloNumPlayer));
+    }
 
     // update legal action bitboard
     empty_board = (one_board_ ^ (board_.get(Player::kPlayer1) | board_.get(Player::kPlayer2))); // places with no pieces
@@ -236,22 +262,7 @@ Player OthelloEnv::eval() const
 }
 std::vector<float> OthelloEnv::getFeatures(utils::Rotation rotation) const
 {
-    std::vector<float> vFeatures;
-    for (int channel = 0; channel < 4; ++channel) {
-        for (int pos = 0; pos < board_size_ * board_size_; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel == 0) {
-                vFeatures.push_back((board_.get(turn_)[rotation_pos] == 1 ? 1.0f : 0.0f));
-            } else if (channel == 1) {
-                vFeatures.push_back((board_.get(getNextPlayer(turn_, kOthelloNumPlayer))[rotation_pos] == 1 ? 1.0f : 0.0f));
-            } else if (channel == 2) {
-                vFeatures.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 3) {
-                vFeatures.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
-        }
-    }
-    return vFeatures;
+    return getOthelloFeatures(board_, turn_, board_size_, rotation);
 }
 
 std::vector<float> OthelloEnv::getActionFeatures(const OthelloAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
@@ -274,4 +285,38 @@ std::vector<float> OthelloEnvLoader::getActionFeatures(const int pos, utils::Rot
     return action_features;
 }
 
+void OthelloEnvLoader::reset()
+{
+    BaseBoardEnvLoader::reset();
+    turns_.clear();
+    boards_.clear();
+}
+
+void OthelloEnvLoader::cacheFeatures()
+{
+    // replay the game once and keep the board of each position
+    turns_.clear();
+    boards_.clear();
+    OthelloEnv env;
+    turns_.push_back(env.getTurn());
+    boards_.push_back(env.getBoard());
+    for (const auto& action_pair : action_pairs_) {
+        if (!env.act(action_pair.first)) { // keep replaying the game for games with illegal actions
+            turns_.clear();
+            boards_.clear();
+            return;
+        }
+        turns_.push_back(env.getTurn());
+        boards_.push_back(env.getBoard());
+    }
+}
+
+std::vector<float> OthelloEnvLoader::getFeatures(const int pos, utils::Rotation rotation /* = utils::Rotation::kRotationNone */) const
+{
+    if (turns_.empty()) { return BaseBoardEnvLoader::getFeatures(pos, rotation); }
+
+    const int index = std::min(pos, static_cast<int>(action_pairs_.size()));
+    return getOthelloFeatures(boards_[index], turns_[index], config::env_board_size, rotation);
+}
+
 } // namespace minizero::env::othello
@@ -17,6 +17,8 @@ typedef std::bitset<kMaxOthelloBoardSize * kMaxOthelloBoardSize> OthelloBitboard
 
 typedef BaseBoardAction<kOthelloNumPlayer> OthelloAction;
 
+std::vector<float> getOthelloFeatures(const GamePair<OthelloBitboard>& board, Player turn, int board_size, utils::Rotation rotation);
+
 class OthelloEnv : public BaseBoardEnv<OthelloAction> {
 public:
     OthelloEnv()
@@ -34,6 +36,7 @@ public:
     float getReward() const override { return 0.0f; }
     float getEvalScore(bool is_resign = false) const override;
     std::vector<float> getFeatures(utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
+    inline uint64_t getFeatureHashKey() const override { return board_hash_key_ ^ getZobristTurnHashKey(turn_); }
     std::vector<float> getActionFeatures(const OthelloAction& action, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     inline int getNumInputChannels() const override { return 4; }
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize() + 1; }
@@ -41,6 +44,7 @@ public:
     inline std::string name() const override { return kOthelloName + "_" + std::to_string(getBoardSize()) + "x" + std::to_string(getBoardSize()); }
     inline int getNumPlayer() const override { return kOthelloNumPlayer; }
     inline bool isPassAction(const OthelloAction& action) const { return (action.getActionID() == getBoardSize() * getBoardSize()); }
+    inline const GamePair<OthelloBitboard>& getBoard() const { return board_; }
 
     inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
@@ -68,10 +72,14 @@ private:
     GamePair<bool> legal_pass_;             // store black/white legal pass
     GamePair<OthelloBitboard> legal_board_; // store black/white legal board
     GamePair<OthelloBitboard> board_;       // store black/white board
+    uint64_t board_hash_key_;               // the Zobrist hash key of board_, which is updated incrementally by act()
 };
 
 class OthelloEnvLoader : public BaseBoardEnvLoader<OthelloAction, OthelloEnv> {
 public:
+    void reset() override;
+    void cacheFeatures() override;
+    std::vector<float> getFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     std::vector<float> getActionFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override;
     inline bool isPassAction(const OthelloAction& action) const { return (action.getActionID() == getBoardSize() * getBoardSize()); }
     inline std::vector<float> getValue(const int pos) const { return {getReturn()}; }
@@ -79,6 +87,10 @@ public:
     inline int getPolicySize() const override { return getBoardSize() * getBoardSize() + 1; }
     inline int getRotatePosition(int position, utils::Rotation rotation) const override { return utils::getPositionByRotating(rotation, position, getBoardSize()); };
     inline int getRotateAction(int action_id, utils::Rotation rotation) const override { return getRotatePosition(action_id, rotation); };
+
+private:
+    std::vector<Player> turns_;                      // the turn of each position
+    std::vector<GamePair<OthelloBitboard>> boards_; // the board of each position
 };
 
 } // namespace minizero::env::othello
@@ -110,11 +110,10 @@ bool Puzzle2048Env::isTerminal() const
 std::vector<float> Puzzle2048Env::getFeatures(utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
 {
     // 16 channels: the nth channel represents the position of the nth tile
-    std::vector<float> features;
+    const int board_area = kPuzzle2048BoardSize * kPuzzle2048BoardSize;
+    std::vector<float> features(16 * board_area, 0.0f);
     for (int tile = 0; tile < 16; ++tile) {
-        for (int pos = 0; pos < 16; ++pos) {
-            features.push_back(board_.get(getRotatePosition(pos, rotation)) == tile ? 1.0f : 0.0f);
-        }
+        utils::writeRotatedPlane(&features[tile * board_area], rotation, kPuzzle2048BoardSize, [this, tile](int pos) { return (board_.get(pos) == tile ? 1.0f : 0.0f); });
     }
     return features;
 }
@@ -190,18 +189,18 @@ float Puzzle2048EnvLoader::calculateNStepValue(const int pos) const
     const float discount = config::actor_mcts_reward_discount;
     size_t bootstrap_index = pos + n_step;
     float value = 0.0f;
-    float n_step_value = ((bootstrap_index < action_pairs_.size()) ? std::pow(discount, n_step) * BaseEnvLoader::getValue(bootstrap_index)[0] : 0.0f);
+    float n_step_value = ((bootstrap_index < action_pairs_.size()) ? std::pow(discount, n_step) * values_[bootstrap_index] : 0.0f);
     for (size_t index = pos; index < std::min(bootstrap_index, action_pairs_.size()); ++index) {
-        float reward = BaseEnvLoader::getReward(index)[0];
+        float reward = rewards_[index];
         value += std::pow(discount, index - pos) * reward;
     }
     value += n_step_value;
     return value;
 }
 
-std::vector<float> Puzzle2048EnvLoader::toDiscreteValue(float value) const
+void Puzzle2048EnvLoader::toDiscreteValue(float value, float* discrete_value) const
 {
-    std::vector<float> discrete_value(kPuzzle2048DiscreteValueSize, 0.0f);
+    std::fill(discrete_value, discrete_value + kPuzzle2048DiscreteValueSize, 0.0f);
     int value_floor = floor(value);
     int value_ceil = ceil(value);
     int shift = kPuzzle2048DiscreteValueSize / 2;
@@ -213,7 +212,6 @@ std::vector<float> Puzzle2048EnvLoader::toDiscreteValue(float value) const
         discrete_value[value_floor_shift] = value_ceil - value;
         discrete_value[value_ceil_shift] = value - value_floor;
     }
-    return discrete_value;
 }
 
 } // namespace minizero::env::puzzle2048
@@ -85,9 +85,21 @@ private:
 class Puzzle2048EnvLoader : public StochasticEnvLoader<Puzzle2048Action, Puzzle2048Env> {
 public:
     std::vector<float> getActionFeatures(const int pos, utils::Rotation rotation = utils::Rotation::kRotationNone) const override { return Puzzle2048Env().getActionFeatures(pos < static_cast<int>(action_pairs_.size()) ? action_pairs_[pos].first : Puzzle2048Action(), rotation); }
-    std::vector<float> getValue(const int pos) const override { return toDiscreteValue(pos < static_cast<int>(action_pairs_.size()) ? utils::transformValue(calculateNStepValue(pos)) : 0.0f); }
-    std::vector<float> getReward(const int pos) const override { return toDiscreteValue(pos < static_cast<int>(action_pairs_.size()) ? utils::transformValue(BaseEnvLoader::getReward(pos)[0]) : 0.0f); }
-    float getPriority(const int pos) const override { return fabs(calculateNStepValue(pos) - BaseEnvLoader::getValue(pos)[0]); }
+    std::vector<float> getValue(const int pos) const override
+    {
+        std::vector<float> value(kPuzzle2048DiscreteValueSize);
+        writeValue(pos, value.data());
+        return value;
+    }
+    void writeValue(const int pos, float* value) const override { toDiscreteValue(pos < static_cast<int>(action_pairs_.size()) ? utils::transformValue(calculateNStepValue(pos)) : 0.0f, value); }
+    std::vector<float> getReward(const int pos) const override
+    {
+        std::vector<float> reward(kPuzzle2048DiscreteValueSize);
+        writeReward(pos, reward.data());
+        return reward;
+    }
+    void writeReward(const int pos, float* reward) const override { toDiscreteValue(pos < static_cast<int>(action_pairs_.size()) ? utils::transformValue(rewards_[pos]) : 0.0f, reward); }
+    float getPriority(const int pos) const override { return fabs(calculateNStepValue(pos) - values_[pos]); }
 
     std::string name() const override { return kPuzzle2048Name; }
     int getPolicySize() const override { return 4; }
@@ -96,7 +108,7 @@ public:
 
 private:
     float calculateNStepValue(const int pos) const;
-    std::vector<float> toDiscreteValue(float value) const;
+    void toDiscreteValue(float value, float* discrete_value) const;
 };
 
 } // namespace minizero::env::puzzle2048
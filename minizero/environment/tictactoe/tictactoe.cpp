@@ -14,6 +14,7 @@ void TicTacToeEnv::reset()
     actions_.clear();
     board_.resize(kTicTacToeBoardSize * kTicTacToeBoardSize);
     fill(board_.begin(), board_.end(), Player::kPlayerNone);
+    board_hash_key_ = 0;
 }
 
 bool TicTacToeEnv::act(const TicTacToeAction& action)
@@ -21,6 +22,7 @@ bool TicTacToeEnv::act(const TicTacToeAction& action)
     if (!isLegalAction(action)) { return false; }
     actions_.push_back(action);
     board_[action.getActionID()] = action.getPlayer();
+    board_hash_key_ ^= getZobristHashKey(action.getActionID(), action.getPlayer());
     turn_ = action.nextPlayer();
     return true;
 }
@@ -71,22 +73,15 @@ std::vector<float> TicTacToeEnv::getFeatures(utils::Rotation rotation /*= utils:
         2. Nought turn
         3. Cross turn
     */
-    std::vector<float> vFeatures;
-    for (int channel = 0; channel < 4; ++channel) {
-        for (int pos = 0; pos < kTicTacToeBoardSize * kTicTacToeBoardSize; ++pos) {
-            int rotation_pos = getRotatePosition(pos, utils::reversed_rotation[static_cast<int>(rotation)]);
-            if (channel == 0) {
-                vFeatures.push_back((board_[rotation_pos] == turn_ ? 1.0f : 0.0f));
-            } else if (channel == 1) {
-                vFeatures.push_back((board_[rotation_pos] == getNextPlayer(turn_, kTicTacToeNumPlayer) ? 1.0f : 0.0f));
-            } else if (channel == 2) {
-                vFeatures.push_back((turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
-            } else if (channel == 3) {
-                vFeatures.push_back((turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
-            }
-        }
-    }
-    return vFeatures;
+    const int board_area = kTicTacToeBoardSize * kTicTacToeBoardSize;
+    const utils::Rotation reversed_rotation = utils::reversed_rotation[static_cast<int>(rotation)];
+    const Player opponent = getNextPlayer(turn_, kTicTacToeNumPlayer);
+    std::vector<float> features(4 * board_area, 0.0f);
+    utils::writeRotatedPlane(&features[0], reversed_rotation, kTicTacToeBoardSize, [this](int pos) { return (board_[pos] == turn_ ? 1.0f : 0.0f); });
+    utils::writeRotatedPlane(&features[board_area], reversed_rotation, kTicTacToeBoardSize, [this, opponent](int pos) { return (board_[pos] == opponent ? 1.0f : 0.0f); });
+    std::fill(features.begin() + 2 * board_area, features.begin() + 3 * board_area, (turn_ == Player::kPlayer1 ? 1.0f : 0.0f));
+    std::fill(features.begin() + 3 * board_area, features.end(), (turn_ == Player::kPlayer2 ? 1.0f : 0.0f));
+    return features;
 }
 
 std::vector<float> TicTacToeEnv::getActionFeatures(const TicTacToeAction& action, utils::Rotation rotation /*= utils::Rotation::kRotationNone*/) const
@@ -3,8 +3,14 @@
 #include "environment.h"
 #include "random.h"
 #include "rotation.h"
+#include "time_system.h"
 #include <algorithm>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
+#include <string_view>
 #include <utility>
 
 namespace minizero::learner {
@@ -12,76 +18,149 @@ namespace minizero::learner {
 using namespace minizero;
 using namespace minizero::utils;
 
+BatchDataBuffer::BatchDataBuffer()
+{
+    // the same sizes as the arrays allocated by train.py
+    Environment env;
+    const int batch_size = config::learner_batch_size;
+    const int num_unrolling_steps = (config::nn_type_name == "alphazero" ? 0 : config::learner_muzero_unrolling_step);
+    features_buffer_.resize(batch_size * env.getNumInputChannels() * env.getInputChannelHeight() * env.getInputChannelWidth());
+    action_features_buffer_.resize(batch_size * num_unrolling_steps * env.getNumActionFeatureChannels() * env.getHiddenChannelHeight() * env.getHiddenChannelWidth());
+    policy_buffer_.resize(batch_size * (num_unrolling_steps + 1) * env.getPolicySize());
+    value_buffer_.resize(batch_size * (num_unrolling_steps + 1) * env.getDiscreteValueSize());
+    reward_buffer_.resize(batch_size * num_unrolling_steps * env.getDiscreteValueSize());
+    loss_scale_buffer_.resize(batch_size);
+    sampled_index_buffer_.resize(2 * batch_size);
+
+    features_ = features_buffer_.data();
+    action_features_ = action_features_buffer_.data();
+    policy_ = policy_buffer_.data();
+    value_ = value_buffer_.data();
+    reward_ = reward_buffer_.data();
+    loss_scale_ = loss_scale_buffer_.data();
+    sampled_index_ = sampled_index_buffer_.data();
+}
+
+void BatchDataBuffer::copyTo(BatchDataPtr& data_ptr) const
+{
+    std::copy(features_buffer_.begin(), features_buffer_.end(), data_ptr.features_);
+    std::copy(action_features_buffer_.begin(), action_features_buffer_.end(), data_ptr.action_features_);
+    std::copy(policy_buffer_.begin(), policy_buffer_.end(), data_ptr.policy_);
+    std::copy(value_buffer_.begin(), value_buffer_.end(), data_ptr.value_);
+    std::copy(reward_buffer_.begin(), reward_buffer_.end(), data_ptr.reward_);
+    std::copy(loss_scale_buffer_.begin(), loss_scale_buffer_.end(), data_ptr.loss_scale_);
+    std::copy(sampled_index_buffer_.begin(), sampled_index_buffer_.end(), data_ptr.sampled_index_);
+}
+
+ReplayGame::ReplayGame(EnvironmentLoader&& env_loader)
+    : env_loader_(std::move(env_loader))
+{
+    std::pair<int, int> data_range = env_loader_.getDataRange();
+    position_priorities_.resize(data_range.second + 1);
+    for (int i = data_range.first; i <= data_range.second; ++i) { position_priorities_.set(i, std::pow((config::learner_use_per ? env_loader_.getPriority(i) : 1.0f), config::learner_per_alpha)); }
+}
+
+std::pair<int, int> ReplayBufferSnapshot::sampleGameAndPos() const
+{
+    int index = game_priorities_.sample(Random::randReal(game_priorities_.getTotal()));
+    const utils::SumTree& position_priorities = games_[index]->position_priorities_;
+    int pos_id = position_priorities.sample(Random::randReal(position_priorities.getTotal()));
+    return {first_game_id_ + index, pos_id};
+}
+
+float ReplayBufferSnapshot::getLossScale(const std::pair<int, int>& p) const
+{
+    if (!config::learner_use_per) { return 1.0f; }
+
+    // calculate importance sampling ratio
+    int game_id = p.first, pos = p.second;
+    float prob = getGame(game_id).position_priorities_.get(pos) / game_priorities_.getTotal();
+    return std::pow((num_data_ * prob), (-config::learner_per_init_beta));
+}
+
 ReplayBuffer::ReplayBuffer()
 {
     num_data_ = 0;
-    game_priority_sum_ = 0.0f;
-    game_priorities_.clear();
-    position_priorities_.clear();
-    env_loaders_.clear();
+    first_game_id_ = 0;
+    iteration_sizes_.clear();
+    games_.clear();
+    snapshot_ = std::make_shared<ReplayBufferSnapshot>();
 }
 
-void ReplayBuffer::addData(const EnvironmentLoader& env_loader)
+void ReplayBuffer::addIteration()
 {
-    std::pair<int, int> data_range = env_loader.getDataRange();
-    std::deque<float> position_priorities(data_range.second + 1, 0.0f);
-    float game_priority = 0.0f;
-    for (int i = data_range.first; i <= data_range.second; ++i) {
-        position_priorities[i] = std::pow((config::learner_use_per ? env_loader.getPriority(i) : 1.0f), config::learner_per_alpha);
-        game_priority += position_priorities[i];
-    }
-
     std::lock_guard<std::mutex> lock(mutex_);
 
-    // add new data to replay buffer
-    num_data_ += (data_range.second - data_range.first + 1);
-    position_priorities_.push_back(position_priorities);
-    game_priorities_.push_back(game_priority);
-    env_loaders_.push_back(env_loader);
-
-    // remove old data if replay buffer is full
-    const size_t replay_buffer_max_size = config::zero_replay_buffer * config::zero_num_games_per_iteration;
-    while (position_priorities_.size() > replay_buffer_max_size) {
-        data_range = env_loaders_.front().getDataRange();
-        num_data_ -= (data_range.second - data_range.first + 1);
-        position_priorities_.pop_front();
-        game_priorities_.pop_front();
-        env_loaders_.pop_front();
+    // remove the oldest iterations if replay buffer is full, which are still visible to samplers until the next publish()
+    while (static_cast<int>(iteration_sizes_.size()) >= std::max(1, config::zero_replay_buffer)) {
+        for (int i = 0; i < iteration_sizes_.front(); ++i) {
+            std::pair<int, int> data_range = games_.front()->env_loader_.getDataRange();
+            num_data_ -= (data_range.second - data_range.first + 1);
+            games_.pop_front();
+        }
+        first_game_id_ += iteration_sizes_.front();
+        iteration_sizes_.pop_front();
     }
+    iteration_sizes_.push_back(0);
 }
 
-std::pair<int, int> ReplayBuffer::sampleEnvAndPos()
+void ReplayBuffer::addData(EnvironmentLoader&& env_loader)
 {
-    int env_id = sampleIndex(game_priorities_);
-    int pos_id = sampleIndex(position_priorities_[env_id]);
-    return {env_id, pos_id};
+    std::shared_ptr<ReplayGame> game = std::make_shared<ReplayGame>(std::move(env_loader));
+    std::pair<int, int> data_range = game->env_loader_.getDataRange();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (iteration_sizes_.empty()) { iteration_sizes_.push_back(0); }
+    ++iteration_sizes_.back();
+    num_data_ += (data_range.second - data_range.first + 1);
+    games_.push_back(game);
 }
 
-int ReplayBuffer::sampleIndex(const std::deque<float>& weight)
+void ReplayBuffer::publish()
 {
-    std::discrete_distribution<> dis(weight.begin(), weight.end());
-    return dis(Random::generator_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<ReplayBufferSnapshot> snapshot = std::make_shared<ReplayBufferSnapshot>();
+    snapshot->num_data_ = num_data_;
+    snapshot->first_game_id_ = first_game_id_;
+    snapshot->games_.assign(games_.begin(), games_.end());
+    snapshot->game_priorities_.resize(games_.size());
+    for (size_t index = 0; index < games_.size(); ++index) { snapshot->game_priorities_.set(index, games_[index]->position_priorities_.getTotal()); }
+    std::atomic_store(&snapshot_, snapshot);
 }
 
-float ReplayBuffer::getLossScale(const std::pair<int, int>& p)
+std::shared_ptr<ReplayGame> ReplayBuffer::getGame(int game_id) const
 {
-    if (!config::learner_use_per) { return 1.0f; }
+    if (game_id < first_game_id_ || game_id >= first_game_id_ + static_cast<int>(games_.size())) { return nullptr; }
+    return games_[game_id - first_game_id_];
+}
 
-    // calculate importance sampling ratio
-    int env_id = p.first, pos = p.second;
-    float prob = position_priorities_[env_id][pos] / game_priority_sum_;
-    return std::pow((num_data_ * prob), (-config::learner_per_init_beta));
+void ReplayBuffer::updateGamePriority(int game_id)
+{
+    // the games added after the last publish() are not visible yet, whose priorities are summed when publishing
+    // the published snapshot is modified in place, which is only safe because the caller holds sampling_mutex_ so that no sampler reads it (stop-the-world by design)
+    if (!snapshot_->hasGame(game_id)) { return; }
+    snapshot_->game_priorities_.set(game_id - snapshot_->first_game_id_, snapshot_->getGame(game_id).position_priorities_.getTotal());
 }
 
 std::string DataLoaderSharedData::getNextEnvString()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
-    std::string env_string = "";
-    if (!env_strings_.empty()) {
-        env_string = env_strings_.front();
-        env_strings_.pop_front();
+    // only complete lines are read, so that a file still being written can be read again from env_file_offset_ later
+    std::lock_guard<std::mutex> lock(loading_mutex_);
+    std::string env_string;
+    while (env_file_.is_open() && std::getline(env_stream_, env_string) && !env_stream_.eof()) {
+        env_file_offset_ += env_string.size() + 1;
+        if (!env_string.empty() && env_game_index_++ % num_shards_ == shard_index_) { return env_string; }
     }
-    return env_string;
+    return "";
+}
+
+int DataLoaderSharedData::getNextRecordIndex()
+{
+    std::lock_guard<std::mutex> lock(loading_mutex_);
+    if (record_index_ >= record_file_.getNumRecords()) { return record_file_.getNumRecords(); }
+    int record_index = record_index_;
+    record_index_ += num_shards_;
+    return record_index;
 }
 
 int DataLoaderSharedData::getNextBatchIndex()
@@ -90,6 +169,13 @@ int DataLoaderSharedData::getNextBatchIndex()
     return (batch_index_ < config::learner_batch_size ? batch_index_++ : config::learner_batch_size);
 }
 
+int DataLoaderSharedData::getNextPriorityGroupIndex()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int num_groups = priority_group_offsets_.size() - 1;
+    return (priority_group_index_ < num_groups ? priority_group_index_++ : num_groups);
+}
+
 void DataLoaderThread::initialize()
 {
     int seed = config::program_auto_seed ? std::random_device()() : config::program_seed + id_;
@@ -98,20 +184,40 @@ void DataLoaderThread::initialize()
 
 void DataLoaderThread::runJob()
 {
-    if (!getSharedData()->env_strings_.empty()) {
+    if (id_ >= getSharedData()->num_sampling_threads_) {
         while (addEnvironmentLoader()) {}
-    } else {
-        while (sampleData()) {}
+        return;
+    }
+
+    switch (getSharedData()->job_) {
+        case DataLoaderJob::kSampleData:
+            while (sampleData()) {}
+            break;
+        case DataLoaderJob::kUpdatePriority:
+            while (updatePriority()) {}
+            break;
     }
 }
 
 bool DataLoaderThread::addEnvironmentLoader()
 {
-    std::string env_string = getSharedData()->getNextEnvString();
-    if (env_string.empty()) { return false; }
-
     EnvironmentLoader env_loader;
-    if (env_loader.loadFromString(env_string)) { getSharedData()->replay_buffer_.addData(env_loader); }
+    if (getSharedData()->record_file_.isOpen()) {
+        int record_index = getSharedData()->getNextRecordIndex();
+        if (record_index >= getSharedData()->record_file_.getNumRecords()) { return false; }
+
+        // read the record in place from the memory-mapped file
+        std::string_view record = getSharedData()->record_file_.getRecord(record_index);
+        if (!env_loader.loadFromBinary(record.data(), record.size())) { return true; }
+    } else {
+        std::string env_string = getSharedData()->getNextEnvString();
+        if (env_string.empty()) { return false; }
+
+        if (!env_loader.loadFromString(env_string)) { return true; }
+    }
+
+    if (config::learner_cache_features) { env_loader.cacheFeatures(); }
+    getSharedData()->replay_buffer_.addData(std::move(env_loader));
     return true;
 }
 
@@ -131,72 +237,86 @@ bool DataLoaderThread::sampleData()
     return true;
 }
 
+bool DataLoaderThread::updatePriority()
+{
+    int group_index = getSharedData()->getNextPriorityGroupIndex();
+    if (group_index >= static_cast<int>(getSharedData()->priority_group_offsets_.size()) - 1) { return false; }
+
+    // all batch indices in a group belong to the same game, so no other thread reads or writes this game
+    const int* sampled_index = getSharedData()->sampled_index_;
+    const float* batch_values = getSharedData()->batch_values_;
+    int first_batch_index = getSharedData()->priority_batch_indices_[getSharedData()->priority_group_offsets_[group_index]];
+    std::shared_ptr<ReplayGame> game = getSharedData()->replay_buffer_.getGame(sampled_index[2 * first_batch_index]);
+    if (!game) { return true; } // the game has been evicted since it was sampled
+
+    for (int i = getSharedData()->priority_group_offsets_[group_index]; i < getSharedData()->priority_group_offsets_[group_index + 1]; ++i) {
+        int batch_index = getSharedData()->priority_batch_indices_[i];
+        int pos_id = sampled_index[2 * batch_index + 1];
+        for (int step = 0; step <= config::learner_muzero_unrolling_step; ++step) {
+            game->env_loader_.setValue(pos_id + step, utils::invertValue(batch_values[step * config::learner_batch_size + batch_index]));
+        }
+        game->position_priorities_.set(pos_id, std::pow(game->env_loader_.getPriority(pos_id), config::learner_per_alpha));
+    }
+    return true;
+}
+
 void DataLoaderThread::setAlphaZeroTrainingData(int batch_index)
 {
     // random pickup one position
-    std::pair<int, int> p = getSharedData()->replay_buffer_.sampleEnvAndPos();
-    int env_id = p.first, pos = p.second;
+    const ReplayBufferSnapshot& snapshot = *getSharedData()->snapshot_;
+    std::pair<int, int> p = snapshot.sampleGameAndPos();
+    int game_id = p.first, pos = p.second;
 
     // AlphaZero training data
-    const EnvironmentLoader& env_loader = getSharedData()->replay_buffer_.env_loaders_[env_id];
+    const EnvironmentLoader& env_loader = snapshot.getGame(game_id).env_loader_;
     Rotation rotation = static_cast<Rotation>(Random::randInt() % static_cast<int>(Rotation::kRotateSize));
-    float loss_scale = getSharedData()->replay_buffer_.getLossScale(p);
+    float loss_scale = snapshot.getLossScale(p);
     std::vector<float> features = env_loader.getFeatures(pos, rotation);
-    std::vector<float> policy = env_loader.getPolicy(pos, rotation);
-    std::vector<float> value = env_loader.getValue(pos);
 
     // write data to data_ptr
-    getSharedData()->getDataPtr()->loss_scale_[batch_index] = loss_scale;
-    getSharedData()->getDataPtr()->sampled_index_[2 * batch_index] = p.first;
-    getSharedData()->getDataPtr()->sampled_index_[2 * batch_index + 1] = p.second;
-    std::copy(features.begin(), features.end(), getSharedData()->getDataPtr()->features_ + features.size() * batch_index);
-    std::copy(policy.begin(), policy.end(), getSharedData()->getDataPtr()->policy_ + policy.size() * batch_index);
-    std::copy(value.begin(), value.end(), getSharedData()->getDataPtr()->value_ + value.size() * batch_index);
+    std::shared_ptr<DataLoaderSharedData> shared_data = getSharedData();
+    std::shared_ptr<BatchDataPtr> data_ptr = shared_data->getDataPtr();
+    data_ptr->loss_scale_[batch_index] = loss_scale;
+    data_ptr->sampled_index_[2 * batch_index] = p.first;
+    data_ptr->sampled_index_[2 * batch_index + 1] = p.second;
+    std::copy(features.begin(), features.end(), data_ptr->features_ + features.size() * batch_index);
+    env_loader.writePolicy(pos, data_ptr->policy_ + shared_data->policy_size_ * batch_index, rotation);
+    env_loader.writeValue(pos, data_ptr->value_ + shared_data->value_size_ * batch_index);
 }
 
 void DataLoaderThread::setMuZeroTrainingData(int batch_index)
 {
     // random pickup one position
-    std::pair<int, int> p = getSharedData()->replay_buffer_.sampleEnvAndPos();
-    int env_id = p.first, pos = p.second;
+    const ReplayBufferSnapshot& snapshot = *getSharedData()->snapshot_;
+    std::pair<int, int> p = snapshot.sampleGameAndPos();
+    int game_id = p.first, pos = p.second;
 
     // MuZero training data
-    const EnvironmentLoader& env_loader = getSharedData()->replay_buffer_.env_loaders_[env_id];
+    const EnvironmentLoader& env_loader = snapshot.getGame(game_id).env_loader_;
     Rotation rotation = static_cast<Rotation>(Random::randInt() % static_cast<int>(Rotation::kRotateSize));
-    float loss_scale = getSharedData()->replay_buffer_.getLossScale(p);
+    float loss_scale = snapshot.getLossScale(p);
     std::vector<float> features = env_loader.getFeatures(pos, rotation);
-    std::vector<float> action_features, policy, value, reward, tmp;
-    for (int step = 0; step <= config::learner_muzero_unrolling_step; ++step) {
-        // action features
-        if (step < config::learner_muzero_unrolling_step) {
-            tmp = env_loader.getActionFeatures(pos + step, rotation);
-            action_features.insert(action_features.end(), tmp.begin(), tmp.end());
-        }
 
-        // policy
-        tmp = env_loader.getPolicy(pos + step, rotation);
-        policy.insert(policy.end(), tmp.begin(), tmp.end());
-
-        // value
-        tmp = env_loader.getValue(pos + step);
-        value.insert(value.end(), tmp.begin(), tmp.end());
-
-        // reward
-        if (step < config::learner_muzero_unrolling_step) {
-            tmp = env_loader.getReward(pos + step);
-            reward.insert(reward.end(), tmp.begin(), tmp.end());
+    // write data to data_ptr, where each unrolling step is written into its slice directly
+    std::shared_ptr<DataLoaderSharedData> shared_data = getSharedData();
+    std::shared_ptr<BatchDataPtr> data_ptr = shared_data->getDataPtr();
+    const int num_unrolling_steps = config::learner_muzero_unrolling_step;
+    float* action_features = data_ptr->action_features_ + shared_data->action_feature_size_ * num_unrolling_steps * batch_index;
+    float* policy = data_ptr->policy_ + shared_data->policy_size_ * (num_unrolling_steps + 1) * batch_index;
+    float* value = data_ptr->value_ + shared_data->value_size_ * (num_unrolling_steps + 1) * batch_index;
+    float* reward = data_ptr->reward_ + shared_data->value_size_ * num_unrolling_steps * batch_index;
+    data_ptr->loss_scale_[batch_index] = loss_scale;
+    data_ptr->sampled_index_[2 * batch_index] = p.first;
+    data_ptr->sampled_index_[2 * batch_index + 1] = p.second;
+    std::copy(features.begin(), features.end(), data_ptr->features_ + features.size() * batch_index);
+    for (int step = 0; step <= num_unrolling_steps; ++step) {
+        env_loader.writePolicy(pos + step, policy + shared_data->policy_size_ * step, rotation);
+        env_loader.writeValue(pos + step, value + shared_data->value_size_ * step);
+        if (step < num_unrolling_steps) {
+            env_loader.writeActionFeatures(pos + step, action_features + shared_data->action_feature_size_ * step, rotation);
+            env_loader.writeReward(pos + step, reward + shared_data->value_size_ * step);
         }
     }
-
-    // write data to data_ptr
-    getSharedData()->getDataPtr()->loss_scale_[batch_index] = loss_scale;
-    getSharedData()->getDataPtr()->sampled_index_[2 * batch_index] = p.first;
-    getSharedData()->getDataPtr()->sampled_index_[2 * batch_index + 1] = p.second;
-    std::copy(features.begin(), features.end(), getSharedData()->getDataPtr()->features_ + features.size() * batch_index);
-    std::copy(action_features.begin(), action_features.end(), getSharedData()->getDataPtr()->action_features_ + action_features.size() * batch_index);
-    std::copy(policy.begin(), policy.end(), getSharedData()->getDataPtr()->policy_ + policy.size() * batch_index);
-    std::copy(value.begin(), value.end(), getSharedData()->getDataPtr()->value_ + value.size() * batch_index);
-    std::copy(reward.begin(), reward.end(), getSharedData()->getDataPtr()->reward_ + reward.size() * batch_index);
 }
 
 DataLoader::DataLoader(const std::string& conf_file_name)
@@ -207,49 +327,238 @@ DataLoader::DataLoader(const std::string& conf_file_name)
     cl.loadFromFile(conf_file_name);
 }
 
+DataLoader::~DataLoader()
+{
+    stopPrefetching();
+}
+
 void DataLoader::initialize()
 {
-    createSlaveThreads(config::learner_num_thread);
+    // the same number of threads for sampling and loading
+    createSlaveThreads(2 * config::learner_num_thread);
+    getSharedData()->num_sampling_threads_ = config::learner_num_thread;
+
+    // the size of action features is taken from a game with one action since it may differ from the size of a hidden channel, e.g., puzzle2048
+    Environment env;
+    EnvironmentLoader env_loader;
+    env.act(env.getLegalActions()[0]);
+    env_loader.loadFromEnvironment(env);
+    getSharedData()->action_feature_size_ = env_loader.getActionFeatures(0).size();
+    getSharedData()->policy_size_ = env.getPolicySize();
+    getSharedData()->value_size_ = env.getDiscreteValueSize();
+    getSharedData()->job_ = DataLoaderJob::kSampleData;
     getSharedData()->createDataPtr();
+    output_data_ptr_ = getSharedData()->getDataPtr();
+    getSharedData()->shard_index_ = 0;
+    getSharedData()->num_shards_ = 1;
+    sgf_file_name_ = "";
+    sgf_file_offset_ = 0;
+    sgf_file_size_ = 0;
+    sgf_game_index_ = 0;
+    stop_prefetching_ = false;
+    getPrefetchStatistics();
 }
 
 void DataLoader::loadDataFromFile(const std::string& file_name)
 {
-    std::ifstream fin(file_name, std::ifstream::in);
-    for (std::string content; std::getline(fin, content);) { getSharedData()->env_strings_.push_back(content); }
+    // each file is an iteration; loading the latest iteration again only reads the games appended to its sgf file since the last loading
+    // the file is not opened again if it has not grown, which avoids decompressing a finished *.sgf.gz from the start to skip its loaded games
+    const std::string binary_suffix = ".bin";
+    const bool is_binary = boost::ends_with(file_name, binary_suffix);
+    std::string sgf_file_name = (is_binary ? file_name.substr(0, file_name.size() - binary_suffix.size()) + ".sgf" : file_name);
+    if (is_binary && !std::ifstream(sgf_file_name) && std::ifstream(sgf_file_name + ".gz")) { sgf_file_name += ".gz"; }
+    std::error_code error_code;
+    const std::uintmax_t sgf_file_size = std::filesystem::file_size(sgf_file_name, error_code);
+    const bool is_new_iteration = (sgf_file_name != sgf_file_name_);
+    if (!is_new_iteration && (sgf_file_offset_ < 0 || sgf_file_size == sgf_file_size_)) { return; }
+    sgf_file_size_ = sgf_file_size;
+    if (is_new_iteration) {
+        getSharedData()->replay_buffer_.addIteration();
+        sgf_file_name_ = sgf_file_name;
+        sgf_file_offset_ = 0;
+        sgf_game_index_ = 0;
+    }
 
-    for (auto& t : slave_threads_) { t->start(); }
-    for (auto& t : slave_threads_) { t->finish(); }
-    getSharedData()->replay_buffer_.game_priority_sum_ = std::accumulate(getSharedData()->replay_buffer_.game_priorities_.begin(), getSharedData()->replay_buffer_.game_priorities_.end(), 0.0f);
+    // binary records (*.bin) are read from a memory-mapped file, otherwise stream one sgf per line
+    if (is_new_iteration && is_binary && getSharedData()->record_file_.open(file_name)) {
+        getSharedData()->record_index_ = getSharedData()->shard_index_;
+        sgf_file_offset_ = -1;
+    } else {
+        if (is_new_iteration && is_binary) { std::cerr << "Failed to load binary records from " << file_name << ", load sgf instead" << std::endl; }
+        // gzip-compressed sgf files (*.sgf.gz) cannot seek, so the games loaded before are decompressed again and skipped
+        getSharedData()->env_file_.open(sgf_file_name, std::ifstream::in | std::ifstream::binary);
+        if (boost::ends_with(sgf_file_name, ".gz")) {
+            getSharedData()->env_stream_.push(boost::iostreams::gzip_decompressor());
+            getSharedData()->env_stream_.push(getSharedData()->env_file_);
+            getSharedData()->env_stream_.ignore(sgf_file_offset_);
+        } else {
+            getSharedData()->env_file_.seekg(sgf_file_offset_);
+            getSharedData()->env_stream_.push(getSharedData()->env_file_);
+        }
+        getSharedData()->env_file_offset_ = sgf_file_offset_;
+        getSharedData()->env_game_index_ = sgf_game_index_;
+    }
+
+    // sampling keeps using the previous snapshot until the loaded games are published
+    runLoadingThreads();
+    getSharedData()->record_file_.close();
+    getSharedData()->env_stream_.reset();
+    if (getSharedData()->env_file_.is_open()) {
+        sgf_file_offset_ = getSharedData()->env_file_offset_;
+        sgf_game_index_ = getSharedData()->env_game_index_;
+        getSharedData()->env_file_.close();
+    }
+    getSharedData()->replay_buffer_.publish();
+}
+
+void DataLoader::setShard(int shard_index, int num_shards)
+{
+    // should be set before loading any data, since the games already loaded are not reloaded
+    assert(num_shards > 0 && shard_index >= 0 && shard_index < num_shards);
+    getSharedData()->shard_index_ = shard_index;
+    getSharedData()->num_shards_ = num_shards;
 }
 
 void DataLoader::sampleData()
 {
-    getSharedData()->batch_index_ = 0;
-    for (auto& t : slave_threads_) { t->start(); }
-    for (auto& t : slave_threads_) { t->finish(); }
+    if (config::learner_num_prefetch_batches <= 0) {
+        stopPrefetching();
+        fillBatch(output_data_ptr_);
+        return;
+    }
+
+    if (!prefetch_thread_) { startPrefetching(); }
+    boost::posix_time::ptime start_ptime = utils::TimeSystem::getLocalTime();
+    std::unique_lock<std::mutex> lock(prefetch_mutex_);
+    ++num_sampled_batches_;
+    total_ready_batches_ += ready_batches_.size();
+    if (ready_batches_.empty()) {
+        ++num_waited_batches_;
+        prefetch_cv_.wait(lock, [this] { return !ready_batches_.empty(); });
+    }
+    int batch_id = ready_batches_.front();
+    ready_batches_.pop_front();
+    lock.unlock();
+
+    batch_buffers_[batch_id]->copyTo(*output_data_ptr_);
+    total_wait_time_us_ += (utils::TimeSystem::getLocalTime() - start_ptime).total_microseconds();
+
+    lock.lock();
+    free_batches_.push_back(batch_id);
+    prefetch_cv_.notify_all();
 }
 
 void DataLoader::updatePriority(int* sampled_index, float* batch_values)
 {
-    // TODO: use multiple threads
-    for (int batch_index = 0; batch_index < config::learner_batch_size; ++batch_index) {
-        int env_id = sampled_index[2 * batch_index];
-        int pos_id = sampled_index[2 * batch_index + 1];
+    // sampling and prefetching wait until the priorities are updated, which also run on the sampling threads
+    std::lock_guard<std::mutex> sampling_lock(sampling_mutex_);
+    std::lock_guard<std::mutex> replay_buffer_lock(getSharedData()->replay_buffer_.mutex_);
+
+    // group the batch indices by game id, keeping the order within a game so that later samples overwrite earlier ones as before
+    std::shared_ptr<DataLoaderSharedData> shared_data = getSharedData();
+    std::vector<int>& batch_indices = shared_data->priority_batch_indices_;
+    batch_indices.resize(config::learner_batch_size);
+    for (int batch_index = 0; batch_index < config::learner_batch_size; ++batch_index) { batch_indices[batch_index] = batch_index; }
+    std::stable_sort(batch_indices.begin(), batch_indices.end(), [sampled_index](int lhs, int rhs) { return sampled_index[2 * lhs] < sampled_index[2 * rhs]; });
+    shared_data->priority_group_offsets_.assign(1, 0);
+    for (int i = 1; i <= config::learner_batch_size; ++i) {
+        if (i == config::learner_batch_size || sampled_index[2 * batch_indices[i]] != sampled_index[2 * batch_indices[i - 1]]) { shared_data->priority_group_offsets_.push_back(i); }
+    }
 
-        EnvironmentLoader& env_loader = getSharedData()->replay_buffer_.env_loaders_[env_id];
-        for (int step = 0; step <= config::learner_muzero_unrolling_step; ++step) {
-            float new_value = utils::invertValue(batch_values[step * config::learner_batch_size + batch_index]);
-            env_loader.setActionPairInfo(pos_id + step, "V", std::to_string(new_value));
-        }
-        getSharedData()->replay_buffer_.position_priorities_[env_id][pos_id] = std::pow(env_loader.getPriority(pos_id), config::learner_per_alpha);
+    // update values and position priorities in parallel, then update the priority of each game
+    shared_data->job_ = DataLoaderJob::kUpdatePriority;
+    shared_data->priority_group_index_ = 0;
+    shared_data->sampled_index_ = sampled_index;
+    shared_data->batch_values_ = batch_values;
+    runSamplingThreads();
+    shared_data->job_ = DataLoaderJob::kSampleData;
+    for (size_t group_index = 0; group_index + 1 < shared_data->priority_group_offsets_.size(); ++group_index) {
+        shared_data->replay_buffer_.updateGamePriority(sampled_index[2 * batch_indices[shared_data->priority_group_offsets_[group_index]]]);
     }
+}
+
+std::map<std::string, float> DataLoader::getPrefetchStatistics()
+{
+    // queue_depth: the average number of ready batches when a batch is requested, close to 0 means that sampling is the bottleneck
+    // wait_ratio: the ratio of requests that wait for a batch to be filled
+    std::lock_guard<std::mutex> lock(prefetch_mutex_);
+    std::map<std::string, float> statistics;
+    statistics["num_batches"] = num_sampled_batches_;
+    statistics["queue_depth"] = (num_sampled_batches_ > 0 ? static_cast<float>(total_ready_batches_) / num_sampled_batches_ : 0.0f);
+    statistics["wait_ratio"] = (num_sampled_batches_ > 0 ? static_cast<float>(num_waited_batches_) / num_sampled_batches_ : 0.0f);
+    statistics["wait_ms_per_batch"] = (num_sampled_batches_ > 0 ? total_wait_time_us_ / 1000 / num_sampled_batches_ : 0.0f);
+    num_sampled_batches_ = num_waited_batches_ = total_ready_batches_ = 0;
+    total_wait_time_us_ = 0.0;
+    return statistics;
+}
+
+void DataLoader::runSamplingThreads()
+{
+    const int num_sampling_threads = getSharedData()->num_sampling_threads_;
+    for (int id = 0; id < num_sampling_threads; ++id) { slave_threads_[id]->start(); }
+    for (int id = 0; id < num_sampling_threads; ++id) { slave_threads_[id]->finish(); }
+}
+
+void DataLoader::runLoadingThreads()
+{
+    const int num_sampling_threads = getSharedData()->num_sampling_threads_;
+    for (size_t id = num_sampling_threads; id < slave_threads_.size(); ++id) { slave_threads_[id]->start(); }
+    for (size_t id = num_sampling_threads; id < slave_threads_.size(); ++id) { slave_threads_[id]->finish(); }
+}
 
-    // recalculate priority to correct floating number error (TODO: speedup this)
-    for (size_t i = 0; i < getSharedData()->replay_buffer_.game_priorities_.size(); ++i) {
-        getSharedData()->replay_buffer_.game_priorities_[i] = std::accumulate(getSharedData()->replay_buffer_.position_priorities_[i].begin(), getSharedData()->replay_buffer_.position_priorities_[i].end(), 0.0f);
+void DataLoader::fillBatch(std::shared_ptr<BaseBatchDataPtr> data_ptr)
+{
+    std::lock_guard<std::mutex> sampling_lock(sampling_mutex_);
+    getSharedData()->job_ = DataLoaderJob::kSampleData;
+    getSharedData()->data_ptr_ = data_ptr;
+    getSharedData()->batch_index_ = 0;
+    getSharedData()->snapshot_ = getSharedData()->replay_buffer_.getSnapshot();
+    runSamplingThreads();
+    getSharedData()->snapshot_ = nullptr;
+}
+
+void DataLoader::startPrefetching()
+{
+    // allocate the ring of batches for the current configuration
+    batch_buffers_.clear();
+    ready_batches_.clear();
+    free_batches_.clear();
+    for (int batch_id = 0; batch_id < config::learner_num_prefetch_batches; ++batch_id) {
+        batch_buffers_.emplace_back(std::make_shared<BatchDataBuffer>());
+        free_batches_.push_back(batch_id);
+    }
+    stop_prefetching_ = false;
+    prefetch_thread_ = std::make_shared<boost::thread>(boost::bind(&DataLoader::runPrefetching, this));
+}
+
+void DataLoader::stopPrefetching()
+{
+    if (!prefetch_thread_) { return; }
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mutex_);
+        stop_prefetching_ = true;
+        prefetch_cv_.notify_all();
+    }
+    prefetch_thread_->join();
+    prefetch_thread_ = nullptr;
+}
+
+void DataLoader::runPrefetching()
+{
+    while (true) {
+        std::unique_lock<std::mutex> lock(prefetch_mutex_);
+        prefetch_cv_.wait(lock, [this] { return stop_prefetching_ || !free_batches_.empty(); });
+        if (stop_prefetching_) { break; }
+        int batch_id = free_batches_.front();
+        free_batches_.pop_front();
+        lock.unlock();
+
+        fillBatch(batch_buffers_[batch_id]);
+
+        lock.lock();
+        ready_batches_.push_back(batch_id);
+        prefetch_cv_.notify_all();
     }
-    getSharedData()->replay_buffer_.game_priority_sum_ = std::accumulate(getSharedData()->replay_buffer_.game_priorities_.begin(), getSharedData()->replay_buffer_.game_priorities_.end(), 0.0f);
 }
 
 } // namespace minizero::learner
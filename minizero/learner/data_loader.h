@@ -2,7 +2,15 @@
 
 #include "environment.h"
 #include "paralleler.h"
+#include "record_file.h"
+#include "sum_tree.h"
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/thread.hpp>
+#include <condition_variable>
+#include <cstdint>
 #include <deque>
+#include <fstream>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <string>
@@ -31,36 +39,123 @@ public:
     int* sampled_index_;
 };
 
+// a batch of training data that owns its memory, used for prefetching batches in the background
+class BatchDataBuffer : public BatchDataPtr {
+public:
+    BatchDataBuffer();
+
+    void copyTo(BatchDataPtr& data_ptr) const;
+
+private:
+    std::vector<float> features_buffer_;
+    std::vector<float> action_features_buffer_;
+    std::vector<float> policy_buffer_;
+    std::vector<float> value_buffer_;
+    std::vector<float> reward_buffer_;
+    std::vector<float> loss_scale_buffer_;
+    std::vector<int> sampled_index_buffer_;
+};
+
+// a game in the replay buffer, where only the values and priorities are modified by updating priorities
+class ReplayGame {
+public:
+    ReplayGame(EnvironmentLoader&& env_loader);
+
+    EnvironmentLoader env_loader_;
+    utils::SumTree position_priorities_; // the priority of each position
+};
+
+// the games visible to samplers, which is immutable after being published except for priority updates (game_priorities_ and the games' values and position priorities)
+// samplers keep using the snapshot they got while newer snapshots are published, and evicted games are freed with the last snapshot holding them
+// priority updates are stop-the-world by design: they write the published snapshot in place while DataLoader holds sampling_mutex_, which also stalls prefetching,
+// since publishing a new snapshot for the priorities updated after every training step would copy the priorities of all games and positions
+class ReplayBufferSnapshot {
+public:
+    ReplayBufferSnapshot() : num_data_(0), first_game_id_(0) {}
+
+    std::pair<int, int> sampleGameAndPos() const;
+    float getLossScale(const std::pair<int, int>& p) const;
+    inline bool hasGame(int game_id) const { return game_id >= first_game_id_ && game_id < first_game_id_ + static_cast<int>(games_.size()); }
+    inline const ReplayGame& getGame(int game_id) const { return *games_[game_id - first_game_id_]; }
+
+    int num_data_;
+    int first_game_id_;             // the id of games_[0], ids increase by one for each added game and never change
+    utils::SumTree game_priorities_; // the sum of position priorities of each game
+    std::vector<std::shared_ptr<ReplayGame>> games_;
+};
+
+// games are added and evicted by whole iterations (keeping the newest zero_replay_buffer iterations) without affecting samplers,
+// which read the snapshot made by the last publish() without taking mutex_, so loading never blocks sampling
+// adding data, publishing, and updating priorities are serialized by mutex_, while only updating priorities stops sampling, see ReplayBufferSnapshot
 class ReplayBuffer {
 public:
     ReplayBuffer();
 
     std::mutex mutex_;
+
+    void addIteration();
+    void addData(EnvironmentLoader&& env_loader);
+    void publish();
+    inline std::shared_ptr<ReplayBufferSnapshot> getSnapshot() const { return std::atomic_load(&snapshot_); }
+
+    // should be called with mutex_ locked
+    std::shared_ptr<ReplayGame> getGame(int game_id) const;
+    void updateGamePriority(int game_id); // writes the published snapshot in place, so sampling must be excluded
+
+private:
     int num_data_;
-    float game_priority_sum_;
-    std::deque<float> game_priorities_;
-    std::deque<std::deque<float>> position_priorities_;
-    std::deque<EnvironmentLoader> env_loaders_;
-
-    void addData(const EnvironmentLoader& env_loader);
-    std::pair<int, int> sampleEnvAndPos();
-    int sampleIndex(const std::deque<float>& weight);
-    float getLossScale(const std::pair<int, int>& p);
+    int first_game_id_;
+    std::deque<int> iteration_sizes_; // the number of games of each iteration, from the oldest
+    std::deque<std::shared_ptr<ReplayGame>> games_;
+    std::shared_ptr<ReplayBufferSnapshot> snapshot_;
+};
+
+enum class DataLoaderJob {
+    kSampleData,
+    kUpdatePriority
 };
 
 class DataLoaderSharedData : public utils::BaseSharedData {
 public:
     std::string getNextEnvString();
+    int getNextRecordIndex();
     int getNextBatchIndex();
+    int getNextPriorityGroupIndex();
 
     virtual void createDataPtr() { data_ptr_ = std::make_shared<BatchDataPtr>(); }
     inline std::shared_ptr<BatchDataPtr> getDataPtr() { return std::static_pointer_cast<BatchDataPtr>(data_ptr_); }
 
+    // threads [0, num_sampling_threads_) sample data and update priorities, and the others load data
+    int num_sampling_threads_;
+    DataLoaderJob job_;
     int batch_index_;
     ReplayBuffer replay_buffer_;
+    std::shared_ptr<ReplayBufferSnapshot> snapshot_; // the snapshot used for sampling the current batch
     std::mutex mutex_;
-    std::deque<std::string> env_strings_;
     std::shared_ptr<BaseBatchDataPtr> data_ptr_;
+
+    // the sizes of the training data of a position, for writing each unrolling step into the batch
+    int action_feature_size_;
+    int policy_size_;
+    int value_size_; // also the size of a reward
+
+    // loading, where each of num_shards_ data loaders only loads the games whose indices in an iteration are shard_index_ modulo num_shards_
+    int shard_index_;
+    int num_shards_;
+    int record_index_;
+    int env_game_index_; // the index of the next game read from env_stream_ in its iteration
+    std::mutex loading_mutex_;
+    std::ifstream env_file_;
+    boost::iostreams::filtering_istream env_stream_; // reads env_file_, which is decompressed if it is a gzip-compressed sgf file
+    std::streamoff env_file_offset_; // the end of the last complete line read from env_stream_, counted in decompressed bytes
+    utils::RecordFileReader record_file_;
+
+    // updating priorities: the batch indices are grouped by game id, so that each game is only updated by one thread
+    int priority_group_index_;
+    int* sampled_index_;
+    float* batch_values_;
+    std::vector<int> priority_batch_indices_;
+    std::vector<int> priority_group_offsets_; // the batch indices of group i are in [priority_group_offsets_[i], priority_group_offsets_[i + 1])
 };
 
 class DataLoaderThread : public utils::BaseSlaveThread {
@@ -75,6 +170,7 @@ public:
 protected:
     virtual bool addEnvironmentLoader();
     virtual bool sampleData();
+    virtual bool updatePriority();
 
     virtual void setAlphaZeroTrainingData(int batch_index);
     virtual void setMuZeroTrainingData(int batch_index);
@@ -82,19 +178,58 @@ protected:
     inline std::shared_ptr<DataLoaderSharedData> getSharedData() { return std::static_pointer_cast<DataLoaderSharedData>(shared_data_); }
 };
 
+// with learner_num_prefetch_batches > 0, a prefetch thread keeps filling a ring of batches in the background using the sampling threads,
+// and sampleData() only copies the oldest ready batch to the output
+// loading data uses separate threads, so that it can overlap with sampling
 class DataLoader : public utils::BaseParalleler {
 public:
     DataLoader(const std::string& conf_file_name);
+    ~DataLoader();
 
     void initialize() override;
     void summarize() override {}
     virtual void loadDataFromFile(const std::string& file_name);
+    void setShard(int shard_index, int num_shards);
     virtual void sampleData();
     virtual void updatePriority(int* sampled_index, float* batch_values);
+    std::map<std::string, float> getPrefetchStatistics();
 
     void createSharedData() override { shared_data_ = std::make_shared<DataLoaderSharedData>(); }
     std::shared_ptr<utils::BaseSlaveThread> newSlaveThread(int id) override { return std::make_shared<DataLoaderThread>(id, shared_data_); }
     inline std::shared_ptr<DataLoaderSharedData> getSharedData() { return std::static_pointer_cast<DataLoaderSharedData>(shared_data_); }
+    inline std::shared_ptr<BatchDataPtr> getOutputDataPtr() { return output_data_ptr_; }
+
+protected:
+    void runSamplingThreads();
+    void runLoadingThreads();
+    void fillBatch(std::shared_ptr<BaseBatchDataPtr> data_ptr);
+    void startPrefetching();
+    void stopPrefetching();
+    void runPrefetching();
+
+    std::shared_ptr<BatchDataPtr> output_data_ptr_; // the batch returned to the caller of sampleData()
+    std::mutex sampling_mutex_;                     // stops sampling (including prefetching) while priorities are updated in the published snapshot
+
+    // the sgf file of the latest iteration, which is read again from sgf_file_offset_ if it is still being written
+    std::string sgf_file_name_;
+    std::streamoff sgf_file_offset_; // -1 if the iteration is loaded from binary records
+    std::uintmax_t sgf_file_size_;   // the size of the sgf file when it was last loaded
+    int sgf_game_index_;             // the index of the game at sgf_file_offset_
+
+    // prefetching
+    bool stop_prefetching_;
+    std::mutex prefetch_mutex_;
+    std::condition_variable prefetch_cv_;
+    std::deque<int> ready_batches_;
+    std::deque<int> free_batches_;
+    std::vector<std::shared_ptr<BatchDataBuffer>> batch_buffers_;
+    std::shared_ptr<boost::thread> prefetch_thread_;
+
+    // statistics of prefetching since the last getPrefetchStatistics()
+    int num_sampled_batches_;
+    int num_waited_batches_;
+    int total_ready_batches_;
+    double total_wait_time_us_;
 };
 
 } // namespace minizero::learner
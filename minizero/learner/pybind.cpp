@@ -39,6 +39,7 @@ PYBIND11_MODULE(minizero_py, m)
     m.def("get_training_step", []() { return config::learner_training_step; });
     m.def("get_training_display_step", []() { return config::learner_training_display_step; });
     m.def("get_batch_size", []() { return config::learner_batch_size; });
+    m.def("get_num_prefetch_batches", []() { return config::learner_num_prefetch_batches; });
     m.def("get_muzero_unrolling_step", []() { return config::learner_muzero_unrolling_step; });
     m.def("get_n_step_return", []() { return config::learner_n_step_return; });
     m.def("get_learning_rate", []() { return config::learner_learning_rate; });
@@ -63,6 +64,7 @@ PYBIND11_MODULE(minizero_py, m)
         .def(py::init<std::string>())
         .def("initialize", &learner::DataLoader::initialize)
         .def("load_data_from_file", &learner::DataLoader::loadDataFromFile, py::call_guard<py::gil_scoped_release>())
+        .def("set_shard", &learner::DataLoader::setShard)
         .def(
             "update_priority", [](learner::DataLoader& data_loader, py::array_t<int>& sampled_index, py::array_t<float>& batch_values) {
                 data_loader.updatePriority(static_cast<int*>(sampled_index.request().ptr), static_cast<float*>(batch_values.request().ptr));
@@ -70,14 +72,15 @@ PYBIND11_MODULE(minizero_py, m)
             py::call_guard<py::gil_scoped_release>())
         .def(
             "sample_data", [](learner::DataLoader& data_loader, py::array_t<float>& features, py::array_t<float>& action_features, py::array_t<float>& policy, py::array_t<float>& value, py::array_t<float>& reward, py::array_t<float>& loss_scale, py::array_t<int>& sampled_index) {
-                data_loader.getSharedData()->getDataPtr()->features_ = static_cast<float*>(features.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->action_features_ = static_cast<float*>(action_features.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->policy_ = static_cast<float*>(policy.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->value_ = static_cast<float*>(value.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->reward_ = static_cast<float*>(reward.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->loss_scale_ = static_cast<float*>(loss_scale.request().ptr);
-                data_loader.getSharedData()->getDataPtr()->sampled_index_ = static_cast<int*>(sampled_index.request().ptr);
+                data_loader.getOutputDataPtr()->features_ = static_cast<float*>(features.request().ptr);
+                data_loader.getOutputDataPtr()->action_features_ = static_cast<float*>(action_features.request().ptr);
+                data_loader.getOutputDataPtr()->policy_ = static_cast<float*>(policy.request().ptr);
+                data_loader.getOutputDataPtr()->value_ = static_cast<float*>(value.request().ptr);
+                data_loader.getOutputDataPtr()->reward_ = static_cast<float*>(reward.request().ptr);
+                data_loader.getOutputDataPtr()->loss_scale_ = static_cast<float*>(loss_scale.request().ptr);
+                data_loader.getOutputDataPtr()->sampled_index_ = static_cast<int*>(sampled_index.request().ptr);
                 data_loader.sampleData();
             },
-            py::call_guard<py::gil_scoped_release>());
+            py::call_guard<py::gil_scoped_release>())
+        .def("get_prefetch_statistics", &learner::DataLoader::getPrefetchStatistics, py::call_guard<py::gil_scoped_release>());
 }
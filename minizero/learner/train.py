@@ -1,8 +1,12 @@
 #!/usr/bin/env python
 
+import datetime
+import os
+import resource
 import sys
 import time
 import torch
+import torch.distributed as dist
 import torch.nn as nn
 import torch.optim as optim
 import numpy as np
@@ -10,14 +14,20 @@ from minizero.network.py.create_network import create_network
 from tools.analysis import analysis
 
 
+# op workers of a group give up the job when a collective operation waits longer than this, e.g., another worker of the group left
+OP_GROUP_TIMEOUT = datetime.timedelta(minutes=5)
+
+
 def eprint(*args, **kwargs):
     print(*args, file=sys.stderr, **kwargs, flush=True)
 
 
 class MinizeroDadaLoader:
-    def __init__(self, conf_file_name):
+    def __init__(self, conf_file_name, shard_index=0, num_shards=1):
         self.data_loader = py.DataLoader(conf_file_name)
         self.data_loader.initialize()
+        self.data_loader.set_shard(shard_index, num_shards)
+        self.shard = (shard_index, num_shards)
         self.data_list = []
 
         # allocate memory
@@ -39,11 +49,18 @@ class MinizeroDadaLoader:
 
     def load_data(self, training_dir, start_iter, end_iter):
         for i in range(start_iter, end_iter + 1):
-            file_name = f"{training_dir}/sgf/{i}.sgf"
-            if file_name in self.data_list:
+            # the latest iteration is loaded again, which only reads the newly written games if its sgf file was still being written
+            if i in self.data_list and i != self.data_list[-1]:
                 continue
+            # prefer the binary records, which are much faster to load than sgf
+            file_name = f"{training_dir}/sgf/{i}.bin"
+            if not os.path.isfile(file_name):
+                file_name = f"{training_dir}/sgf/{i}.sgf"
+            if not os.path.isfile(file_name):
+                file_name = f"{training_dir}/sgf/{i}.sgf.gz"
             self.data_loader.load_data_from_file(file_name)
-            self.data_list.append(file_name)
+            if i not in self.data_list:
+                self.data_list.append(i)
             if len(self.data_list) > py.get_zero_replay_buffer():
                 self.data_list.pop(0)
 
@@ -67,6 +84,9 @@ class MinizeroDadaLoader:
         batch_values = (batch_values * self.value_accumulator).sum(axis=1)
         self.data_loader.update_priority(sampled_index, batch_values)
 
+    def get_prefetch_statistics(self):
+        return self.data_loader.get_prefetch_statistics()
+
 
 class Model:
     def __init__(self):
@@ -151,13 +171,32 @@ def calculate_accuracy(output, label, batch_size):
     return (max_output == max_label).sum() / batch_size
 
 
-def train(model, training_dir, data_loader, start_iter, end_iter):
+def average_gradients(network):
+    # data-parallel training: the gradients of all op workers are averaged, so that their models stay the same
+    grads = [param.grad for param in network.parameters() if param.grad is not None]
+    flat_grads = torch.cat([grad.view(-1) for grad in grads])
+    dist.all_reduce(flat_grads)
+    flat_grads /= dist.get_world_size()
+    offset = 0
+    for grad in grads:
+        grad.copy_(flat_grads[offset:offset + grad.numel()].view_as(grad))
+        offset += grad.numel()
+
+
+def load_data(training_dir, data_loader, start_iter, end_iter):
     if start_iter == -1:
-        model.save_model(training_dir)
         return
 
-    # load data
     data_loader.load_data(training_dir, start_iter, end_iter)
+    eprint("[{}] load data, peak rss: {} MB.".format(time.strftime("%Y-%m-%d %H:%M:%S", time.localtime()), resource.getrusage(resource.RUSAGE_SELF).ru_maxrss // 1024))
+
+
+def train(model, training_dir, data_loader, start_iter, end_iter, job_id=None):
+    is_main_worker = not dist.is_initialized() or dist.get_rank() == 0
+    if start_iter == -1:
+        if is_main_worker:
+            model.save_model(training_dir)
+        return
 
     training_info = {}
     for i in range(1, py.get_training_step() + 1):
@@ -206,6 +245,8 @@ def train(model, training_dir, data_loader, start_iter, end_iter):
                 add_training_info(training_info, 'loss_reward', loss_reward.item())
 
         loss.backward()
+        if dist.is_initialized():
+            average_gradients(model.network)
         model.optimizer.step()
         model.scheduler.step()
 
@@ -214,12 +255,39 @@ def train(model, training_dir, data_loader, start_iter, end_iter):
             eprint("[{}] nn step {}, lr: {}.".format(time.strftime("%Y-%m-%d %H:%M:%S", time.localtime()), model.training_step, round(model.optimizer.param_groups[0]["lr"], 6)))
             for loss in training_info:
                 eprint("\t{}: {}".format(loss, round(training_info[loss] / py.get_training_display_step(), 5)))
+            if py.get_num_prefetch_batches() > 0:
+                prefetch_statistics = data_loader.get_prefetch_statistics()
+                eprint("\tprefetch: " + ", ".join("{}: {}".format(key, round(value, 3)) for key, value in prefetch_statistics.items()))
             training_info = {}
 
-    model.save_model(training_dir)
-    print("Optimization_Done", model.training_step, flush=True)
-    eprint("Optimization_Done", model.training_step)
-    analysis(training_dir, "analysis")
+    # the models of all op workers are the same, so only the first one saves it
+    if is_main_worker:
+        model.save_model(training_dir)
+    done_message = "Optimization_Done {}".format(model.training_step) + ("" if job_id is None else " {}".format(job_id))
+    print(done_message, flush=True)
+    eprint(done_message)
+    if is_main_worker:
+        analysis(training_dir, "analysis")
+
+
+def train_in_group(model, training_dir, data_loader, start_iter, end_iter, rank, num_op_workers, job_id, group_name):
+    # the data is loaded before joining the group, so that the timeout only covers the time that workers wait for each other
+    load_data(training_dir, data_loader, start_iter, end_iter)
+    group_file = f"{os.path.abspath(training_dir)}/model/{group_name}"
+    try:
+        dist.init_process_group("gloo", init_method=f"file://{group_file}", rank=rank, world_size=num_op_workers, timeout=OP_GROUP_TIMEOUT)
+        train(model, training_dir, data_loader, start_iter, end_iter, job_id)
+    except RuntimeError as e:
+        # the server dispatches the job again after all workers of the group give it up
+        eprint("Optimization failed: {}".format(e))
+        print("Optimization_Failed {}".format(job_id), flush=True)
+    finally:
+        if dist.is_initialized():
+            dist.destroy_process_group()
+        try:
+            os.remove(group_file)
+        except FileNotFoundError:
+            pass
 
 
 if __name__ == '__main__':
@@ -253,14 +321,25 @@ if __name__ == '__main__':
                     eprint("Failed to load configuration string.")
                     exit(0)
             elif command_prefix == "train":
-                _, model_file, start_iter, end_iter = command.split()
+                # format: train model_file start_iter end_iter [rank num_op_workers job_id group_name]
+                args = command.split()
+                _, model_file, start_iter, end_iter = args[:4]
                 model_file = model_file.replace('"', '')
+                rank, num_op_workers, job_id, group_name = (int(args[4]), int(args[5]), args[6], args[7]) if len(args) == 8 else (0, 1, None, None)
 
                 # skip loading model if the model is loaded
-                if model.network is None:
+                # op workers training together always load the model saved by the group, since a worker of a failed job keeps a partially trained one
+                if model.network is None or num_op_workers > 1:
                     model.load_model(training_dir, model_file)
 
-                train(model, training_dir, data_loader, int(start_iter), int(end_iter))
+                # several op workers train together, where each one loads its own shard of the replay buffer
+                if data_loader.shard != (rank, num_op_workers):
+                    data_loader = MinizeroDadaLoader(conf_file_name, rank, num_op_workers)
+                if num_op_workers > 1:
+                    train_in_group(model, training_dir, data_loader, int(start_iter), int(end_iter), rank, num_op_workers, job_id, group_name)
+                else:
+                    load_data(training_dir, data_loader, int(start_iter), int(end_iter))
+                    train(model, training_dir, data_loader, int(start_iter), int(end_iter))
             elif command_prefix == "quit":
                 exit(0)
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "network.h"
+#include "nn_evaluation_cache.h"
 #include "utils.h"
 #include <algorithm>
 #include <memory>
@@ -13,15 +14,27 @@ namespace minizero::network {
 class AlphaZeroNetworkOutput : public NetworkOutput {
 public:
     float value_;
-    std::vector<float> policy_;
-    std::vector<float> policy_logits_;
+    NetworkOutputSpan policy_;
+    NetworkOutputSpan policy_logits_;
 
-    AlphaZeroNetworkOutput(int policy_size)
+    AlphaZeroNetworkOutput() : value_(0.0f) {}
+    AlphaZeroNetworkOutput(const AlphaZeroNetworkOutput&) = delete;
+    AlphaZeroNetworkOutput& operator=(const AlphaZeroNetworkOutput&) = delete;
+
+    std::shared_ptr<NetworkOutput> clone() const override
     {
-        value_ = 0.0f;
-        policy_.resize(policy_size, 0.0f);
-        policy_logits_.resize(policy_size, 0.0f);
+        std::shared_ptr<AlphaZeroNetworkOutput> output = std::make_shared<AlphaZeroNetworkOutput>();
+        output->value_ = value_;
+        output->data_.reserve(policy_.size() + policy_logits_.size());
+        output->data_.insert(output->data_.end(), policy_.begin(), policy_.end());
+        output->data_.insert(output->data_.end(), policy_logits_.begin(), policy_logits_.end());
+        output->policy_ = NetworkOutputSpan(output->data_.data(), policy_.size());
+        output->policy_logits_ = NetworkOutputSpan(output->data_.data() + policy_.size(), policy_logits_.size());
+        return output;
     }
+
+private:
+    std::vector<float> data_; // only used by clones, outputs of a forward are views into the output tensors
 };
 
 class AlphaZeroNetwork : public Network {
@@ -35,7 +48,9 @@ public:
     {
         assert(batch_size_ == 0); // should avoid loading model when batch size is not 0
         Network::loadModel(nn_file_name, gpu_id);
+        tensor_input_ = createInputBuffer(kReserved_batch_size, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth());
         clear();
+        nn_evaluation_cache_.clear();
     }
 
     std::string toString() const override
@@ -45,77 +60,78 @@ public:
         return oss.str();
     }
 
-    int pushBack(std::vector<float> features)
+    int pushBack(const std::vector<float>& features)
     {
-        assert(static_cast<int>(features.size()) == getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth());
-        assert(batch_size_ < kReserved_batch_size);
+        const int feature_size = getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth();
+        assert(static_cast<int>(features.size()) == feature_size);
 
         int index;
         {
             std::lock_guard<std::mutex> lock(mutex_);
+            assert(batch_size_ < kReserved_batch_size);
             index = batch_size_++;
-            tensor_input_.resize(batch_size_);
         }
-        tensor_input_[index] = torch::from_blob(features.data(), {1, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}).clone();
+        // each index is reserved by exactly one caller, so the features can be written into the buffer without holding the lock
+        std::copy(features.begin(), features.end(), tensor_input_.data_ptr<float>() + index * feature_size);
         return index;
     }
 
     std::vector<std::shared_ptr<NetworkOutput>> forward()
     {
         assert(batch_size_ > 0);
-        auto forward_result = network_.forward(std::vector<torch::jit::IValue>{torch::cat(tensor_input_).to(getDevice())}).toGenericDict();
-
-        auto policy_output = forward_result.at("policy").toTensor().to(at::kCPU);
-        auto policy_logits_output = forward_result.at("policy_logit").toTensor().to(at::kCPU);
-        auto value_output = forward_result.at("value").toTensor().to(at::kCPU);
-        assert(policy_output.numel() == batch_size_ * getActionSize());
-        assert(policy_logits_output.numel() == batch_size_ * getActionSize());
-        assert(value_output.numel() == batch_size_ * getDiscreteValueSize());
-
-        const int policy_size = getActionSize();
-        std::vector<std::shared_ptr<NetworkOutput>> network_outputs;
-        for (int i = 0; i < batch_size_; ++i) {
-            network_outputs.emplace_back(std::make_shared<AlphaZeroNetworkOutput>(policy_size));
-            auto alphazero_network_output = std::static_pointer_cast<AlphaZeroNetworkOutput>(network_outputs.back());
-
-            // policy & policy logits
-            std::copy(policy_output.data_ptr<float>() + i * policy_size,
-                      policy_output.data_ptr<float>() + (i + 1) * policy_size,
-                      alphazero_network_output->policy_.begin());
-            std::copy(policy_logits_output.data_ptr<float>() + i * policy_size,
-                      policy_logits_output.data_ptr<float>() + (i + 1) * policy_size,
-                      alphazero_network_output->policy_logits_.begin());
+        auto forward_result = network_.forward(std::vector<torch::jit::IValue>{tensor_input_.narrow(0, 0, batch_size_).to(getDevice(), /*non_blocking=*/true)}).toGenericDict();
+
+        auto network_outputs = unpackOutputs(forward_result.at("policy").toTensor().to(at::kCPU),
+                                             forward_result.at("policy_logit").toTensor().to(at::kCPU),
+                                             forward_result.at("value").toTensor().to(at::kCPU),
+                                             batch_size_);
+        clear();
+        return network_outputs;
+    }
+
+    // wraps the output tensors of a batch into the outputs of each sample without copying policies
+    static std::vector<std::shared_ptr<NetworkOutput>> unpackOutputs(const torch::Tensor& policy_output, const torch::Tensor& policy_logits_output, const torch::Tensor& value_output, int batch_size)
+    {
+        const int policy_size = policy_output.numel() / batch_size;
+        const int discrete_value_size = value_output.numel() / batch_size;
+        assert(policy_output.numel() == batch_size * policy_size);
+        assert(policy_logits_output.numel() == batch_size * policy_size);
+        assert(value_output.numel() == batch_size * discrete_value_size);
+
+        auto batch_output = std::make_shared<NetworkBatchOutput<AlphaZeroNetworkOutput>>(batch_size, std::vector<torch::Tensor>{policy_output, policy_logits_output, value_output});
+        const float* policy = policy_output.data_ptr<float>();
+        const float* policy_logits = policy_logits_output.data_ptr<float>();
+        const float* value = value_output.data_ptr<float>();
+        for (int i = 0; i < batch_size; ++i) {
+            AlphaZeroNetworkOutput& alphazero_network_output = batch_output->outputs_[i];
+            alphazero_network_output.policy_ = NetworkOutputSpan(policy + i * policy_size, policy_size);
+            alphazero_network_output.policy_logits_ = NetworkOutputSpan(policy_logits + i * policy_size, policy_size);
 
             // value
-            if (getDiscreteValueSize() == 1) {
-                alphazero_network_output->value_ = value_output[i].item<float>();
+            if (discrete_value_size == 1) {
+                alphazero_network_output.value_ = value[i];
             } else {
-                int start_value = -getDiscreteValueSize() / 2;
-                alphazero_network_output->value_ = std::accumulate(value_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                   value_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                   0.0f,
-                                                                   [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                alphazero_network_output->value_ = utils::invertValue(alphazero_network_output->value_);
+                int start_value = -discrete_value_size / 2;
+                alphazero_network_output.value_ = std::accumulate(value + i * discrete_value_size,
+                                                                  value + (i + 1) * discrete_value_size,
+                                                                  0.0f,
+                                                                  [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                alphazero_network_output.value_ = utils::invertValue(alphazero_network_output.value_);
             }
         }
-
-        clear();
-        return network_outputs;
+        return NetworkBatchOutput<AlphaZeroNetworkOutput>::getNetworkOutputs(batch_output);
     }
 
     inline int getBatchSize() const { return batch_size_; }
+    inline NNEvaluationCache& getNNEvaluationCache() { return nn_evaluation_cache_; }
 
 protected:
-    inline void clear()
-    {
-        batch_size_ = 0;
-        tensor_input_.clear();
-        tensor_input_.reserve(kReserved_batch_size);
-    }
+    inline void clear() { batch_size_ = 0; }
 
     int batch_size_;
     std::mutex mutex_;
-    std::vector<torch::Tensor> tensor_input_;
+    torch::Tensor tensor_input_; // kReserved_batch_size x C x H x W
+    NNEvaluationCache nn_evaluation_cache_;
 
     const int kReserved_batch_size = 4096;
 };
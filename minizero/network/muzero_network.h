@@ -15,18 +15,31 @@ class MuZeroNetworkOutput : public NetworkOutput {
 public:
     float value_;
     float reward_;
-    std::vector<float> policy_;
-    std::vector<float> policy_logits_;
-    std::vector<float> hidden_state_;
+    NetworkOutputSpan policy_;
+    NetworkOutputSpan policy_logits_;
+    NetworkOutputSpan hidden_state_;
 
-    MuZeroNetworkOutput(int policy_size, int hidden_state_size)
+    MuZeroNetworkOutput() : value_(0.0f), reward_(0.0f) {}
+    MuZeroNetworkOutput(const MuZeroNetworkOutput&) = delete;
+    MuZeroNetworkOutput& operator=(const MuZeroNetworkOutput&) = delete;
+
+    std::shared_ptr<NetworkOutput> clone() const override
     {
-        value_ = 0.0f;
-        reward_ = 0.0f;
-        policy_.resize(policy_size, 0.0f);
-        policy_logits_.resize(policy_size, 0.0f);
-        hidden_state_.resize(hidden_state_size, 0.0f);
+        std::shared_ptr<MuZeroNetworkOutput> output = std::make_shared<MuZeroNetworkOutput>();
+        output->value_ = value_;
+        output->reward_ = reward_;
+        output->data_.reserve(policy_.size() + policy_logits_.size() + hidden_state_.size());
+        output->data_.insert(output->data_.end(), policy_.begin(), policy_.end());
+        output->data_.insert(output->data_.end(), policy_logits_.begin(), policy_logits_.end());
+        output->data_.insert(output->data_.end(), hidden_state_.begin(), hidden_state_.end());
+        output->policy_ = NetworkOutputSpan(output->data_.data(), policy_.size());
+        output->policy_logits_ = NetworkOutputSpan(output->data_.data() + policy_.size(), policy_logits_.size());
+        output->hidden_state_ = NetworkOutputSpan(output->data_.data() + policy_.size() + policy_logits_.size(), hidden_state_.size());
+        return output;
     }
+
+private:
+    std::vector<float> data_; // only used by clones, outputs of a forward are views into the output tensors
 };
 
 class MuZeroNetwork : public Network {
@@ -35,12 +48,6 @@ public:
     {
         num_action_feature_channels_ = -1;
         initial_input_batch_size_ = recurrent_input_batch_size_ = 0;
-        initial_tensor_input_.clear();
-        initial_tensor_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_feature_input_.clear();
-        recurrent_tensor_feature_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_action_input_.clear();
-        recurrent_tensor_action_input_.reserve(kReserved_batch_size);
     }
 
     void loadModel(const std::string& nn_file_name, const int gpu_id) override
@@ -49,6 +56,9 @@ public:
 
         std::vector<torch::jit::IValue> dummy;
         num_action_feature_channels_ = network_.get_method("get_num_action_feature_channels")(dummy).toInt();
+        initial_tensor_input_ = createInputBuffer(kReserved_batch_size, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth());
+        recurrent_tensor_feature_input_ = createInputBuffer(kReserved_batch_size, getNumHiddenChannels(), getHiddenChannelHeight(), getHiddenChannelWidth());
+        recurrent_tensor_action_input_ = createInputBuffer(kReserved_batch_size, getNumActionFeatureChannels(), getHiddenChannelHeight(), getHiddenChannelWidth());
         initial_input_batch_size_ = 0;
         recurrent_input_batch_size_ = 0;
     }
@@ -61,43 +71,43 @@ public:
         return oss.str();
     }
 
-    int pushBackInitialData(std::vector<float> features)
+    int pushBackInitialData(const std::vector<float>& features)
     {
-        assert(static_cast<int>(features.size()) == getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth());
+        const int feature_size = getNumInputChannels() * getInputChannelHeight() * getInputChannelWidth();
+        assert(static_cast<int>(features.size()) == feature_size);
 
         int index;
         {
             std::lock_guard<std::mutex> lock(initial_mutex_);
+            assert(initial_input_batch_size_ < kReserved_batch_size);
             index = initial_input_batch_size_++;
-            initial_tensor_input_.resize(initial_input_batch_size_);
         }
-        initial_tensor_input_[index] = torch::from_blob(features.data(), {1, getNumInputChannels(), getInputChannelHeight(), getInputChannelWidth()}).clone();
+        std::copy(features.begin(), features.end(), initial_tensor_input_.data_ptr<float>() + index * feature_size);
         return index;
     }
 
-    int pushBackRecurrentData(std::vector<float> features, std::vector<float> actions)
+    int pushBackRecurrentData(const std::vector<float>& features, const std::vector<float>& actions)
     {
-        assert(static_cast<int>(features.size()) == getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
-        assert(static_cast<int>(actions.size()) == getNumActionFeatureChannels() * getHiddenChannelHeight() * getHiddenChannelWidth());
+        const int feature_size = getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth();
+        const int action_size = getNumActionFeatureChannels() * getHiddenChannelHeight() * getHiddenChannelWidth();
+        assert(static_cast<int>(features.size()) == feature_size);
+        assert(static_cast<int>(actions.size()) == action_size);
 
         int index;
         {
             std::lock_guard<std::mutex> lock(recurrent_mutex_);
+            assert(recurrent_input_batch_size_ < kReserved_batch_size);
             index = recurrent_input_batch_size_++;
-            recurrent_tensor_feature_input_.resize(recurrent_input_batch_size_);
-            recurrent_tensor_action_input_.resize(recurrent_input_batch_size_);
         }
-        recurrent_tensor_feature_input_[index] = torch::from_blob(features.data(), {1, getNumHiddenChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}).clone();
-        recurrent_tensor_action_input_[index] = torch::from_blob(actions.data(), {1, getNumActionFeatureChannels(), getHiddenChannelHeight(), getHiddenChannelWidth()}).clone();
+        std::copy(features.begin(), features.end(), recurrent_tensor_feature_input_.data_ptr<float>() + index * feature_size);
+        std::copy(actions.begin(), actions.end(), recurrent_tensor_action_input_.data_ptr<float>() + index * action_size);
         return index;
     }
 
     inline std::vector<std::shared_ptr<NetworkOutput>> initialInference()
     {
         assert(initial_input_batch_size_ > 0);
-        auto outputs = forward("initial_inference", {torch::cat(initial_tensor_input_).to(getDevice())}, initial_input_batch_size_);
-        initial_tensor_input_.clear();
-        initial_tensor_input_.reserve(kReserved_batch_size);
+        auto outputs = forward("initial_inference", {initial_tensor_input_.narrow(0, 0, initial_input_batch_size_).to(getDevice(), /*non_blocking=*/true)}, initial_input_batch_size_);
         initial_input_batch_size_ = 0;
         return outputs;
     }
@@ -106,12 +116,9 @@ public:
     {
         assert(recurrent_input_batch_size_ > 0);
         auto outputs = forward("recurrent_inference",
-                               {{torch::cat(recurrent_tensor_feature_input_).to(getDevice())}, {torch::cat(recurrent_tensor_action_input_).to(getDevice())}},
+                               {{recurrent_tensor_feature_input_.narrow(0, 0, recurrent_input_batch_size_).to(getDevice(), /*non_blocking=*/true)},
+                                {recurrent_tensor_action_input_.narrow(0, 0, recurrent_input_batch_size_).to(getDevice(), /*non_blocking=*/true)}},
                                recurrent_input_batch_size_);
-        recurrent_tensor_feature_input_.clear();
-        recurrent_tensor_feature_input_.reserve(kReserved_batch_size);
-        recurrent_tensor_action_input_.clear();
-        recurrent_tensor_action_input_.reserve(kReserved_batch_size);
         recurrent_input_batch_size_ = 0;
         return outputs;
     }
@@ -139,42 +146,39 @@ protected:
 
         const int policy_size = getActionSize();
         const int hidden_state_size = getNumHiddenChannels() * getHiddenChannelHeight() * getHiddenChannelWidth();
-        std::vector<std::shared_ptr<NetworkOutput>> network_outputs;
+        auto batch_output = std::make_shared<NetworkBatchOutput<MuZeroNetworkOutput>>(batch_size, std::vector<torch::Tensor>{policy_output, policy_logits_output, value_output, reward_output, hidden_state_output});
+        const float* policy = policy_output.data_ptr<float>();
+        const float* policy_logits = policy_logits_output.data_ptr<float>();
+        const float* value = value_output.data_ptr<float>();
+        const float* reward = reward_output.data_ptr<float>();
+        const float* hidden_state = hidden_state_output.data_ptr<float>();
         for (int i = 0; i < batch_size; ++i) {
-            network_outputs.emplace_back(std::make_shared<MuZeroNetworkOutput>(policy_size, hidden_state_size));
-            auto muzero_network_output = std::static_pointer_cast<MuZeroNetworkOutput>(network_outputs.back());
-
-            std::copy(policy_output.data_ptr<float>() + i * policy_size,
-                      policy_output.data_ptr<float>() + (i + 1) * policy_size,
-                      muzero_network_output->policy_.begin());
-            std::copy(policy_logits_output.data_ptr<float>() + i * policy_size,
-                      policy_logits_output.data_ptr<float>() + (i + 1) * policy_size,
-                      muzero_network_output->policy_logits_.begin());
-            std::copy(hidden_state_output.data_ptr<float>() + i * hidden_state_size,
-                      hidden_state_output.data_ptr<float>() + (i + 1) * hidden_state_size,
-                      muzero_network_output->hidden_state_.begin());
+            MuZeroNetworkOutput& muzero_network_output = batch_output->outputs_[i];
+            muzero_network_output.policy_ = NetworkOutputSpan(policy + i * policy_size, policy_size);
+            muzero_network_output.policy_logits_ = NetworkOutputSpan(policy_logits + i * policy_size, policy_size);
+            muzero_network_output.hidden_state_ = NetworkOutputSpan(hidden_state + i * hidden_state_size, hidden_state_size);
 
             if (getNetworkTypeName() == "muzero_atari") {
                 int start_value = -getDiscreteValueSize() / 2;
-                muzero_network_output->value_ = std::accumulate(value_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                value_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                0.0f,
-                                                                [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                muzero_network_output->value_ = utils::invertValue(muzero_network_output->value_);
+                muzero_network_output.value_ = std::accumulate(value + i * getDiscreteValueSize(),
+                                                               value + (i + 1) * getDiscreteValueSize(),
+                                                               0.0f,
+                                                               [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                muzero_network_output.value_ = utils::invertValue(muzero_network_output.value_);
                 if (forward_result.contains("reward")) {
                     start_value = -getDiscreteValueSize() / 2;
-                    muzero_network_output->reward_ = std::accumulate(reward_output.data_ptr<float>() + i * getDiscreteValueSize(),
-                                                                     reward_output.data_ptr<float>() + (i + 1) * getDiscreteValueSize(),
-                                                                     0.0f,
-                                                                     [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
-                    muzero_network_output->reward_ = utils::invertValue(muzero_network_output->reward_);
+                    muzero_network_output.reward_ = std::accumulate(reward + i * getDiscreteValueSize(),
+                                                                    reward + (i + 1) * getDiscreteValueSize(),
+                                                                    0.0f,
+                                                                    [&start_value](const float& sum, const float& value) { return sum + value * start_value++; });
+                    muzero_network_output.reward_ = utils::invertValue(muzero_network_output.reward_);
                 }
             } else {
-                muzero_network_output->value_ = value_output[i].item<float>();
+                muzero_network_output.value_ = value[i];
             }
         }
 
-        return network_outputs;
+        return NetworkBatchOutput<MuZeroNetworkOutput>::getNetworkOutputs(batch_output);
     }
 
     int num_action_feature_channels_;
@@ -182,9 +186,9 @@ protected:
     int recurrent_input_batch_size_;
     std::mutex initial_mutex_;
     std::mutex recurrent_mutex_;
-    std::vector<torch::Tensor> initial_tensor_input_;
-    std::vector<torch::Tensor> recurrent_tensor_feature_input_;
-    std::vector<torch::Tensor> recurrent_tensor_action_input_;
+    torch::Tensor initial_tensor_input_;           // kReserved_batch_size x C x H x W
+    torch::Tensor recurrent_tensor_feature_input_; // kReserved_batch_size x hidden C x hidden H x hidden W
+    torch::Tensor recurrent_tensor_action_input_;  // kReserved_batch_size x action C x hidden H x hidden W
 
     const int kReserved_batch_size = 4096;
 };
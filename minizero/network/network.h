@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <torch/script.h>
@@ -7,9 +8,51 @@
 
 namespace minizero::network {
 
+// a read-only view of the output of a sample in a batched output tensor
+class NetworkOutputSpan {
+public:
+    NetworkOutputSpan() : data_(nullptr), size_(0) {}
+    NetworkOutputSpan(const float* data, size_t size) : data_(data), size_(size) {}
+
+    inline const float* begin() const { return data_; }
+    inline const float* end() const { return data_ + size_; }
+    inline const float* data() const { return data_; }
+    inline size_t size() const { return size_; }
+    inline bool empty() const { return size_ == 0; }
+    inline const float& operator[](size_t index) const { return data_[index]; }
+    inline operator std::vector<float>() const { return std::vector<float>(begin(), end()); }
+
+private:
+    const float* data_;
+    size_t size_;
+};
+
 class NetworkOutput {
 public:
     virtual ~NetworkOutput() = default;
+
+    // returns a copy that owns its data, which does not keep the whole batch alive
+    virtual std::shared_ptr<NetworkOutput> clone() const = 0;
+};
+
+// the outputs of a forward, which keeps the output tensors alive so that the output of each sample is only a view into them
+template <class NetworkOutputType>
+class NetworkBatchOutput {
+public:
+    NetworkBatchOutput(int batch_size, const std::vector<torch::Tensor>& tensors)
+        : tensors_(tensors), outputs_(batch_size) {}
+
+    // the returned pointers share the ownership of the batch, so no allocation is needed for each sample
+    static std::vector<std::shared_ptr<NetworkOutput>> getNetworkOutputs(const std::shared_ptr<NetworkBatchOutput>& batch_output)
+    {
+        std::vector<std::shared_ptr<NetworkOutput>> network_outputs;
+        network_outputs.reserve(batch_output->outputs_.size());
+        for (auto& output : batch_output->outputs_) { network_outputs.emplace_back(batch_output, &output); }
+        return network_outputs;
+    }
+
+    std::vector<torch::Tensor> tensors_;
+    std::vector<NetworkOutputType> outputs_;
 };
 
 class Network {
@@ -38,6 +81,12 @@ public:
 protected:
     inline torch::Device getDevice() const { return (gpu_id_ == -1 ? torch::Device("cpu") : torch::Device(torch::kCUDA, gpu_id_)); }
 
+    // a contiguous host buffer for a batch of inputs, pinned on GPU so that copying a batch to the device can be asynchronous
+    inline torch::Tensor createInputBuffer(int batch_size, int num_channels, int channel_height, int channel_width) const
+    {
+        return torch::empty({batch_size, num_channels, channel_height, channel_width}, torch::TensorOptions().dtype(torch::kFloat).pinned_memory(getDevice().is_cuda()));
+    }
+
     int gpu_id_;
     int num_input_channels_;
     int input_channel_height_;
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "network.h"
+#include "rotation.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace minizero::network {
+
+// a bounded, thread-safe cache of network outputs keyed by the hash key of features
+class NNEvaluationCache {
+public:
+    class Entry {
+    public:
+        uint64_t key_;
+        utils::Rotation rotation_; // the rotation of the features when evaluated
+        std::shared_ptr<NetworkOutput> network_output_;
+    };
+
+    NNEvaluationCache() { resize(0); }
+
+    // not thread-safe, should be called before searching
+    inline void resize(int size)
+    {
+        entries_.clear();
+        entries_.resize(size);
+        resetCounters();
+    }
+
+    inline void clear()
+    {
+        for (size_t index = 0; index < entries_.size(); ++index) {
+            std::lock_guard<std::mutex> lock(getMutex(index));
+            entries_[index].network_output_ = nullptr;
+        }
+        resetCounters();
+    }
+
+    inline bool lookup(uint64_t key, Entry& entry)
+    {
+        if (!isEnabled() || key == 0) { return false; }
+        ++num_lookups_;
+        const size_t index = key % entries_.size();
+        std::lock_guard<std::mutex> lock(getMutex(index));
+        if (!entries_[index].network_output_ || entries_[index].key_ != key) { return false; }
+        ++num_hits_;
+        entry = entries_[index];
+        return true;
+    }
+
+    inline void store(uint64_t key, utils::Rotation rotation, const std::shared_ptr<NetworkOutput>& network_output)
+    {
+        if (!isEnabled() || key == 0) { return; }
+        std::shared_ptr<NetworkOutput> cached_output = network_output->clone(); // do not keep the whole batch of network_output alive
+        const size_t index = key % entries_.size();                              // always replace the old entry
+        std::lock_guard<std::mutex> lock(getMutex(index));
+        entries_[index].key_ = key;
+        entries_[index].rotation_ = rotation;
+        entries_[index].network_output_ = cached_output;
+    }
+
+    inline void resetCounters() { num_lookups_ = num_hits_ = 0; }
+    inline bool isEnabled() const { return !entries_.empty(); }
+    inline int getSize() const { return entries_.size(); }
+    inline uint64_t getNumLookups() const { return num_lookups_; }
+    inline uint64_t getNumHits() const { return num_hits_; }
+    inline float getHitRate() const { return (num_lookups_ > 0 ? static_cast<float>(num_hits_) / num_lookups_ : 0.0f); }
+
+private:
+    inline std::mutex& getMutex(size_t index) { return mutexes_[index % kNumMutexes]; }
+
+    static const int kNumMutexes = 64;
+    std::mutex mutexes_[kNumMutexes];
+    std::vector<Entry> entries_;
+    std::atomic<uint64_t> num_lookups_;
+    std::atomic<uint64_t> num_hits_;
+};
+
+} // namespace minizero::network
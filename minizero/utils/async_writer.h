@@ -0,0 +1,122 @@
+#pragma once
+
+#include "mpsc_queue.h"
+#include <atomic>
+#include <boost/thread.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+namespace minizero::utils {
+
+// writes lines to a stream on a dedicated thread, so that the threads producing lines never block on I/O
+// the writer thread sleeps on a condition variable when the queue is empty, and write() only takes the lock to wake it up while it is sleeping
+class AsyncWriter {
+public:
+    AsyncWriter()
+        : os_(nullptr),
+          stop_(false),
+          waiting_(false),
+          num_written_bytes_(0),
+          write_microseconds_(0) {}
+
+    // writers overriding writeLine() or flush() must call stop() in their own destructors
+    virtual ~AsyncWriter() { stop(); }
+
+    // the transform is applied on the writer thread before writing each line, e.g., to compress it
+    // the delimiter is written after each line, which is empty for messages that are already framed
+    void start(std::ostream& os, std::function<std::string(const std::string&)> transform = nullptr, const std::string& delimiter = "\n")
+    {
+        stop();
+        os_ = &os;
+        transform_ = transform;
+        delimiter_ = delimiter;
+        startThread();
+    }
+
+    // writes all remaining lines before returning
+    void stop()
+    {
+        if (!thread_) { return; }
+        stop_ = true;
+        notify();
+        thread_->join();
+        thread_ = nullptr;
+    }
+
+    inline void write(std::string line)
+    {
+        queue_.push(std::move(line));
+        // the queue size and waiting_ are sequentially consistent, so either the writer thread sees the line before sleeping, or this thread sees it waiting
+        if (waiting_) { notify(); }
+    }
+    inline int getQueueSize() const { return queue_.size(); }
+    inline uint64_t getNumWrittenBytes() const { return num_written_bytes_.load(std::memory_order_relaxed); }
+    // the time spent on writing and flushing, excluding the time waiting for lines
+    inline double getWriteSeconds() const { return write_microseconds_.load(std::memory_order_relaxed) / 1e6; }
+
+protected:
+    void startThread()
+    {
+        stop_ = false;
+        thread_ = std::make_shared<boost::thread>(boost::bind(&AsyncWriter::run, this));
+    }
+
+    inline void notify()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cv_.notify_one();
+    }
+
+    virtual void writeLine(const std::string& line) { *os_ << line << delimiter_; }
+    virtual void flush() { os_->flush(); }
+
+    void run()
+    {
+        std::string line;
+        while (true) {
+            // read the flag before draining, so that lines written before stop() are never left behind
+            bool stop = stop_;
+            bool written = false;
+            auto start_time = std::chrono::steady_clock::now();
+            while (queue_.pop(line)) {
+                if (transform_) { line = transform_(line); }
+                writeLine(line);
+                num_written_bytes_.fetch_add(line.size() + delimiter_.size(), std::memory_order_relaxed);
+                written = true;
+            }
+
+            // flush once per drained batch instead of once per line
+            if (written) {
+                flush();
+                write_microseconds_.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count(), std::memory_order_relaxed);
+            } else if (stop) {
+                break;
+            } else {
+                std::unique_lock<std::mutex> lock(mutex_);
+                waiting_ = true;
+                cv_.wait(lock, [this] { return !queue_.empty() || stop_; });
+                waiting_ = false;
+            }
+        }
+    }
+
+    std::ostream* os_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> waiting_; // the writer thread is waiting on cv_ for lines
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<uint64_t> num_written_bytes_;
+    std::atomic<uint64_t> write_microseconds_;
+    std::function<std::string(const std::string&)> transform_;
+    std::string delimiter_;
+    MPSCQueue<std::string> queue_;
+    std::shared_ptr<boost::thread> thread_;
+};
+
+} // namespace minizero::utils
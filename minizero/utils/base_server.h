@@ -1,9 +1,11 @@
 #pragma once
 
+#include "wire_frame.h"
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/thread.hpp>
+#include <atomic>
 #include <queue>
 #include <string>
 #include <vector>
@@ -29,30 +31,44 @@ public:
         strand_.dispatch(boost::bind(&ConnectionHandler::doWrite, shared_from_this(), message));
     }
 
+    // reads, writes, and closing of a connection are serialized by its strand, so that several io threads can serve different connections
+    // a message is either a text line or a binary frame (see wire_frame.h), which is distinguished by its first byte
     void startRead()
     {
-        boost::asio::async_read_until(socket_,
-                                      read_buffer_, '\n',
-                                      boost::bind(&ConnectionHandler::handleRead,
-                                                  shared_from_this(),
-                                                  boost::asio::placeholders::error,
-                                                  boost::asio::placeholders::bytes_transferred));
+        if (read_buffer_.size() == 0) {
+            readAtLeast(1);
+        } else if (getReadData()[0] == kWireFrameMagic[0]) {
+            readFrame();
+        } else {
+            boost::asio::async_read_until(socket_,
+                                          read_buffer_, '\n',
+                                          strand_.wrap(boost::bind(&ConnectionHandler::handleRead,
+                                                                   shared_from_this(),
+                                                                   boost::asio::placeholders::error,
+                                                                   boost::asio::placeholders::bytes_transferred)));
+        }
     }
 
     virtual void close()
     {
-        if (is_closed_) { return; }
+        if (is_closed_.exchange(true)) { return; }
 
-        is_closed_ = true;
-        socket_.close();
+        strand_.dispatch(boost::bind(&ConnectionHandler::doClose, shared_from_this()));
     }
 
     inline bool isClosed() const { return is_closed_; }
     inline boost::asio::ip::tcp::socket& getSocket() { return socket_; }
 
     virtual void handleReceivedMessage(const std::string& message) = 0;
+    virtual void handleReceivedFrame(const char* payload, size_t size) { close(); }
 
 private:
+    void doClose()
+    {
+        boost::system::error_code error;
+        socket_.close(error);
+    }
+
     void doWrite(const std::string& message)
     {
         message_queue_.push(message);
@@ -79,6 +95,46 @@ private:
         if (!message_queue_.empty()) { writeNext(); }
     }
 
+    inline const char* getReadData() const { return static_cast<const char*>(read_buffer_.data().data()); }
+
+    void readAtLeast(size_t size)
+    {
+        boost::asio::async_read(socket_,
+                                read_buffer_, boost::asio::transfer_at_least(size - read_buffer_.size()),
+                                strand_.wrap(boost::bind(&ConnectionHandler::handleReadAtLeast,
+                                                         shared_from_this(),
+                                                         boost::asio::placeholders::error)));
+    }
+
+    void handleReadAtLeast(const boost::system::error_code& error)
+    {
+        if (error) {
+            close();
+            return;
+        }
+        startRead();
+    }
+
+    // the payload is passed as a view into the read buffer, so that frames are never copied by the connection
+    void readFrame()
+    {
+        uint32_t payload_size = 0;
+        if (read_buffer_.size() < kWireFrameHeaderSize) {
+            readAtLeast(kWireFrameHeaderSize);
+            return;
+        } else if (!parseWireFrameHeader(getReadData(), payload_size)) {
+            close();
+            return;
+        } else if (read_buffer_.size() < kWireFrameHeaderSize + payload_size) {
+            readAtLeast(kWireFrameHeaderSize + payload_size);
+            return;
+        }
+
+        handleReceivedFrame(getReadData() + kWireFrameHeaderSize, payload_size);
+        read_buffer_.consume(kWireFrameHeaderSize + payload_size);
+        if (!isClosed()) { startRead(); }
+    }
+
     void handleRead(const boost::system::error_code& error, size_t bytes_read)
     {
         if (error) {
@@ -86,24 +142,25 @@ private:
             return;
         }
 
+        // the line buffer is kept per connection, so that its capacity is reused by the following messages
         std::istream is(&read_buffer_);
-        std::string line;
-        std::getline(is, line);
-        handleReceivedMessage(line);
-        startRead();
+        std::getline(is, read_line_);
+        handleReceivedMessage(read_line_);
+        if (!isClosed()) { startRead(); }
     }
 
-    bool is_closed_;
+    std::atomic<bool> is_closed_;
     std::queue<std::string> message_queue_;
     boost::asio::ip::tcp::socket socket_;
     boost::asio::io_service::strand strand_;
     boost::asio::streambuf read_buffer_;
+    std::string read_line_;
 };
 
 template <class _ConnectionHandler>
 class BaseServer {
 public:
-    BaseServer(int port)
+    BaseServer(int port, int num_threads = 1)
         : work_(io_service_),
           acceptor_(io_service_)
     {
@@ -113,7 +170,6 @@ public:
         acceptor_.bind(endpoint);
         acceptor_.listen();
 
-        const int num_threads = 1;
         for (int i = 0; i < num_threads; ++i) {
             thread_pool_.create_thread(boost::bind(&BaseServer::run, this));
         }
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace minizero::utils {
+
+// a lock-free multiple-producer single-consumer queue; producers never wait for each other or for the consumer
+// reference: Dmitry Vyukov, Non-intrusive MPSC node-based queue
+template <class T>
+class MPSCQueue {
+public:
+    MPSCQueue()
+        : size_(0)
+    {
+        tail_ = new Node();
+        head_.store(tail_, std::memory_order_relaxed);
+    }
+
+    ~MPSCQueue()
+    {
+        T value;
+        while (pop(value)) {}
+        delete tail_;
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // thread-safe for multiple producers
+    void push(T value)
+    {
+        Node* node = new Node(std::move(value));
+        size_.fetch_add(1); // sequentially consistent, so that a consumer announcing that it waits and then checking empty() never misses a push
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next_.store(node, std::memory_order_release);
+    }
+
+    // only called by the single consumer; may return false for a moment while a push is in progress
+    bool pop(T& value)
+    {
+        Node* next = tail_->next_.load(std::memory_order_acquire);
+        if (!next) { return false; }
+        value = std::move(next->value_);
+        delete tail_;
+        tail_ = next;
+        size_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    inline int size() const { return size_.load(); }
+    inline bool empty() const { return size() == 0; }
+
+private:
+    class Node {
+    public:
+        Node() : next_(nullptr) {}
+        Node(T value) : next_(nullptr), value_(std::move(value)) {}
+
+        std::atomic<Node*> next_;
+        T value_;
+    };
+
+    std::atomic<Node*> head_; // the most recently pushed node
+    Node* tail_;              // the dummy node before the oldest node, only accessed by the consumer
+    std::atomic<int> size_;
+};
+
+} // namespace minizero::utils
@@ -1,11 +1,46 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <boost/thread.hpp>
+#include <cassert>
 #include <memory>
+#include <utility>
 #include <vector>
 
 namespace minizero::utils {
 
+// dispenses the indices [0, size) to multiple threads without locks, in chunks to reduce the contention on the shared counter
+class IndexDispenser {
+public:
+    IndexDispenser() { reset(0, 1); }
+
+    // not thread-safe, should be called before dispensing
+    inline void reset(int size, int chunk_size)
+    {
+        assert(chunk_size > 0);
+        size_ = size;
+        chunk_size_ = chunk_size;
+        next_index_.store(0, std::memory_order_relaxed);
+    }
+
+    // returns the range [begin, end) of the next chunk, which is empty if all indices are dispensed
+    inline std::pair<int, int> getNextChunk()
+    {
+        int begin = next_index_.fetch_add(chunk_size_, std::memory_order_relaxed);
+        if (begin >= size_) { return {size_, size_}; }
+        return {begin, std::min(begin + chunk_size_, size_)};
+    }
+
+    inline int getSize() const { return size_; }
+    inline int getChunkSize() const { return chunk_size_; }
+
+private:
+    int size_;
+    int chunk_size_;
+    std::atomic<int> next_index_;
+};
+
 class BaseSharedData {
 public:
     BaseSharedData() {}
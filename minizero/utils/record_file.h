@@ -0,0 +1,179 @@
+#pragma once
+
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace minizero::utils {
+
+// appends fixed-width values, arrays, and length-prefixed strings to a binary record
+class RecordBuilder {
+public:
+    template <class T>
+    inline void write(const T& value) { write(&value, 1); }
+
+    template <class T>
+    inline void write(const T* values, size_t size)
+    {
+        static_assert(std::is_trivially_copyable<T>::value);
+        record_.append(reinterpret_cast<const char*>(values), sizeof(T) * size);
+    }
+
+    inline void writeString(const std::string& str)
+    {
+        write(static_cast<uint32_t>(str.size()));
+        record_.append(str);
+    }
+
+    inline const std::string& getRecord() const { return record_; }
+
+private:
+    std::string record_;
+};
+
+// reads a binary record written by RecordBuilder; every read fails instead of reading past the end of the record
+class RecordParser {
+public:
+    RecordParser(const char* data, size_t size) : data_(data), end_(data + size) {}
+
+    template <class T>
+    inline bool read(T& value) { return read(&value, 1); }
+
+    template <class T>
+    inline bool read(T* values, size_t size)
+    {
+        static_assert(std::is_trivially_copyable<T>::value);
+        if (static_cast<size_t>(end_ - data_) < sizeof(T) * size) { return false; }
+        if (size > 0) { std::memcpy(values, data_, sizeof(T) * size); } // records are not aligned
+        data_ += sizeof(T) * size;
+        return true;
+    }
+
+    inline bool readString(std::string& str)
+    {
+        uint32_t size = 0;
+        if (!read(size) || static_cast<size_t>(end_ - data_) < size) { return false; }
+        str.assign(data_, size);
+        data_ += size;
+        return true;
+    }
+
+    inline bool isEnd() const { return data_ == end_; }
+
+private:
+    const char* data_;
+    const char* end_;
+};
+
+// a file of binary records followed by an index of record offsets
+// layout: header magic, record 0, ..., record n-1, offset of record 0, ..., offset of record n-1, n, footer magic
+// the index is written when closing, so that a file without the footer magic (e.g., the writer crashed) is rejected by the reader
+class RecordFileWriter {
+public:
+    ~RecordFileWriter() { close(); }
+
+    bool open(const std::string& file_name)
+    {
+        close();
+        fout_.open(file_name, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!fout_) { return false; }
+        fout_.write(kHeaderMagic, kMagicSize);
+        offset_ = kMagicSize;
+        offsets_.clear();
+        return true;
+    }
+
+    void write(const std::string& record)
+    {
+        if (!isOpen()) { return; }
+        fout_.write(record.data(), record.size());
+        offsets_.push_back(offset_);
+        offset_ += record.size();
+    }
+
+    void close()
+    {
+        if (!isOpen()) { return; }
+        uint64_t num_records = offsets_.size();
+        fout_.write(reinterpret_cast<const char*>(offsets_.data()), sizeof(uint64_t) * offsets_.size());
+        fout_.write(reinterpret_cast<const char*>(&num_records), sizeof(uint64_t));
+        fout_.write(kFooterMagic, kMagicSize);
+        fout_.close();
+    }
+
+    inline bool isOpen() const { return fout_.is_open(); }
+    inline int getNumRecords() const { return offsets_.size(); }
+
+    static constexpr size_t kMagicSize = 8;
+    static constexpr const char* kHeaderMagic = "MZRECORD";
+    static constexpr const char* kFooterMagic = "MZINDEX0";
+
+private:
+    uint64_t offset_;
+    std::vector<uint64_t> offsets_;
+    std::ofstream fout_;
+};
+
+// reads records in place from a memory-mapped file, without copying the file into memory
+class RecordFileReader {
+public:
+    bool open(const std::string& file_name)
+    {
+        close();
+        try {
+            file_.open(file_name);
+        } catch (const std::exception&) {
+            return false;
+        }
+
+        // validate the magics and the index before accepting the file
+        const size_t kMagicSize = RecordFileWriter::kMagicSize;
+        const size_t file_size = file_.size();
+        if (file_size < 2 * kMagicSize + sizeof(uint64_t) ||
+            std::memcmp(file_.data(), RecordFileWriter::kHeaderMagic, kMagicSize) != 0 ||
+            std::memcmp(file_.data() + file_size - kMagicSize, RecordFileWriter::kFooterMagic, kMagicSize) != 0) {
+            close();
+            return false;
+        }
+        uint64_t num_records = 0;
+        std::memcpy(&num_records, file_.data() + file_size - kMagicSize - sizeof(uint64_t), sizeof(uint64_t));
+        if (num_records > (file_size - 2 * kMagicSize - sizeof(uint64_t)) / sizeof(uint64_t)) {
+            close();
+            return false;
+        }
+        index_offset_ = file_size - kMagicSize - sizeof(uint64_t) * (num_records + 1);
+        offsets_.resize(num_records);
+        std::memcpy(offsets_.data(), file_.data() + index_offset_, sizeof(uint64_t) * num_records);
+        for (size_t i = 0; i < offsets_.size(); ++i) {
+            if (offsets_[i] < kMagicSize || offsets_[i] > getRecordEnd(i) || getRecordEnd(i) > index_offset_) {
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void close()
+    {
+        if (file_.is_open()) { file_.close(); }
+        offsets_.clear();
+    }
+
+    inline bool isOpen() const { return file_.is_open(); }
+    inline int getNumRecords() const { return offsets_.size(); }
+    inline std::string_view getRecord(int index) const { return std::string_view(file_.data() + offsets_[index], getRecordEnd(index) - offsets_[index]); }
+
+private:
+    inline uint64_t getRecordEnd(size_t index) const { return (index + 1 < offsets_.size() ? offsets_[index + 1] : index_offset_); }
+
+    uint64_t index_offset_;
+    std::vector<uint64_t> offsets_;
+    boost::iostreams::mapped_file_source file_;
+};
+
+} // namespace minizero::utils
@@ -38,6 +38,8 @@ const std::string rotation_string[static_cast<int>(Rotation::kRotateSize)] = {
     "Horizontal_Rotation_180_Degree",
     "Horizontal_Rotation_270_Degree"};
 
+const int kMaxRotationBoardSize = 19;
+
 inline std::string getRotationString(Rotation rotate) { return rotation_string[static_cast<int>(rotate)]; }
 
 inline Rotation getRotationFromString(const std::string rotation_str)
@@ -48,7 +50,7 @@ inline Rotation getRotationFromString(const std::string rotation_str)
     return Rotation::kRotateSize;
 }
 
-inline int getPositionByRotating(Rotation rotation, int original_pos, int board_size)
+inline int calculatePositionByRotating(Rotation rotation, int original_pos, int board_size)
 {
     assert(original_pos >= 0 && original_pos <= board_size * board_size);
     if (original_pos == board_size * board_size) { return original_pos; }
@@ -92,4 +94,49 @@ inline int getPositionByRotating(Rotation rotation, int original_pos, int board_
     return new_pos;
 }
 
+// rotation tables for every board size up to kMaxRotationBoardSize, each table maps all positions (including pass) of the board
+inline const std::vector<int>& getRotationTable(Rotation rotation, int board_size)
+{
+    assert(board_size > 0 && board_size <= kMaxRotationBoardSize);
+    static const std::vector<std::vector<int>> rotation_tables = []() {
+        const int rotate_size = static_cast<int>(Rotation::kRotateSize);
+        std::vector<std::vector<int>> tables((kMaxRotationBoardSize + 1) * rotate_size);
+        for (int size = 1; size <= kMaxRotationBoardSize; ++size) {
+            for (int rotation_index = 0; rotation_index < rotate_size; ++rotation_index) {
+                std::vector<int>& table = tables[size * rotate_size + rotation_index];
+                table.resize(size * size + 1);
+                for (int pos = 0; pos <= size * size; ++pos) { table[pos] = calculatePositionByRotating(static_cast<Rotation>(rotation_index), pos, size); }
+            }
+        }
+        return tables;
+    }();
+    return rotation_tables[board_size * static_cast<int>(Rotation::kRotateSize) + static_cast<int>(rotation)];
+}
+
+inline int getPositionByRotating(Rotation rotation, int original_pos, int board_size)
+{
+    assert(original_pos >= 0 && original_pos <= board_size * board_size);
+    if (board_size > kMaxRotationBoardSize) { return calculatePositionByRotating(rotation, original_pos, board_size); }
+    return getRotationTable(rotation, board_size)[original_pos];
+}
+
+// plane[pos] = value(getPositionByRotating(rotation, pos, board_size)) for every position on the board
+template <class Function>
+inline void writeRotatedPlane(float* plane, Rotation rotation, int board_size, Function&& value)
+{
+    const int board_area = board_size * board_size;
+    if (board_size > kMaxRotationBoardSize) {
+        for (int pos = 0; pos < board_area; ++pos) { plane[pos] = value(calculatePositionByRotating(rotation, pos, board_size)); }
+        return;
+    }
+    const int* table = getRotationTable(rotation, board_size).data();
+    for (int pos = 0; pos < board_area; ++pos) { plane[pos] = value(table[pos]); }
+}
+
+// dst[pos] = src[getPositionByRotating(rotation, pos, board_size)], src and dst must not overlap
+inline void rotatePlane(const float* src, float* dst, Rotation rotation, int board_size)
+{
+    writeRotatedPlane(dst, rotation, board_size, [src](int pos) { return src[pos]; });
+}
+
 } // namespace minizero::utils
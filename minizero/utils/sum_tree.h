@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace minizero::utils {
+
+// a complete binary tree whose leaves are priorities and whose internal nodes are the sums of their children
+// sampling proportionally to priorities and updating a priority take O(log n), and the total priority takes O(1)
+// not thread-safe for updating, but any number of threads can sample concurrently while no thread is updating
+class SumTree {
+public:
+    SumTree(int size = 0) { resize(size); }
+
+    // clears all priorities to zero
+    void resize(int size)
+    {
+        size_ = size;
+        num_leaves_ = 1;
+        while (num_leaves_ < size_) { num_leaves_ *= 2; }
+        tree_.assign(2 * num_leaves_, 0.0);
+    }
+
+    // sums are recalculated from the children instead of adding the difference, so floating-point errors do not accumulate
+    void set(int index, double priority)
+    {
+        assert(index >= 0 && index < size_);
+        int node = num_leaves_ + index;
+        tree_[node] = priority;
+        for (node /= 2; node >= 1; node /= 2) { tree_[node] = tree_[2 * node] + tree_[2 * node + 1]; }
+    }
+
+    // returns the index of the leaf where the prefix sum of priorities exceeds value, value should be in [0, getTotal())
+    int sample(double value) const
+    {
+        int node = 1;
+        while (node < num_leaves_) {
+            const int left = 2 * node;
+            if (value < tree_[left] || tree_[left + 1] <= 0.0) {
+                node = left;
+            } else {
+                value -= tree_[left];
+                node = left + 1;
+            }
+        }
+        return std::min(node - num_leaves_, size_ - 1);
+    }
+
+    inline double get(int index) const { return tree_[num_leaves_ + index]; }
+    inline double getTotal() const { return tree_[1]; }
+    inline int size() const { return size_; }
+
+private:
+    int size_;
+    int num_leaves_;
+    std::vector<double> tree_; // tree_[1] is the root, and tree_[num_leaves_ + i] is the i-th leaf
+};
+
+} // namespace minizero::utils
@@ -8,6 +8,7 @@
 #include <iomanip>
 #include <numeric>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -36,14 +37,14 @@ inline std::vector<std::string> stringToVector(const std::string& s, const std::
     return args;
 }
 
-inline std::string compressToBinaryString(const std::string& s)
+inline std::string compressToBinaryString(const std::string& s, int level = boost::iostreams::zlib::default_compression)
 {
     if (s.empty()) { return s; }
 
     // use gzip to compress string
     std::stringstream compressed;
     boost::iostreams::filtering_streambuf<boost::iostreams::output> out;
-    out.push(boost::iostreams::gzip_compressor());
+    out.push(boost::iostreams::gzip_compressor(boost::iostreams::gzip_params(level)));
     out.push(compressed);
     boost::iostreams::copy(boost::iostreams::basic_array_source<char>{s.data(), s.size()}, out);
     boost::iostreams::close(out);
@@ -53,20 +54,28 @@ inline std::string compressToBinaryString(const std::string& s)
 inline std::string binaryToHexString(const std::string& s)
 {
     // encode binary string to hex string
-    std::ostringstream oss;
+    const char* hex_digits = "0123456789abcdef";
+    std::string hex_string(s.size() * 2, '0');
     for (size_t i = 0; i < s.size(); ++i) {
-        oss << std::setfill('0') << std::setw(2) << std::hex << static_cast<int>(static_cast<unsigned char>(s[i]));
+        hex_string[2 * i] = hex_digits[static_cast<unsigned char>(s[i]) >> 4];
+        hex_string[2 * i + 1] = hex_digits[static_cast<unsigned char>(s[i]) & 0xf];
     }
-    return oss.str();
+    return hex_string;
 }
 
 inline std::string hexToBinaryString(const std::string& s)
 {
     assert(s.size() % 2 == 0);
 
-    // decode hex string to binary string
-    std::string decompressed_string;
-    for (size_t i = 0; i < s.size(); i += 2) { decompressed_string += static_cast<unsigned char>(std::stoi(s.substr(i, 2), 0, 16)); }
+    // decode hex string to binary string, invalid digits throw like std::stoi
+    auto hex_value = [](char c) {
+        if (c >= '0' && c <= '9') { return c - '0'; }
+        if (c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+        if (c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+        throw std::invalid_argument("hexToBinaryString");
+    };
+    std::string decompressed_string(s.size() / 2, '\0');
+    for (size_t i = 0; i < decompressed_string.size(); ++i) { decompressed_string[i] = static_cast<char>(hex_value(s[2 * i]) << 4 | hex_value(s[2 * i + 1])); }
     return decompressed_string;
 }
 
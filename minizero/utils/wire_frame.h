@@ -0,0 +1,67 @@
+#pragma once
+
+#include "record_file.h"
+#include "utils.h"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace minizero::utils {
+
+// a length-prefixed binary message between workers and the zero server, which is used instead of a text line when both sides support it
+// layout: magic (4 bytes), payload size (uint32_t), payload
+// the magic starts with a zero byte, which never starts a text message, so that frames and text lines can be mixed on a connection
+constexpr size_t kWireFrameHeaderSize = 8;
+constexpr size_t kWireFrameMaxPayloadSize = 1u << 30;
+constexpr char kWireFrameMagic[4] = {'\0', 'M', 'Z', 'F'};
+
+// the first byte of a payload
+enum class WireMessageType : uint8_t {
+    kSelfPlay = 1
+};
+
+// payload of a self-play game: type, is_terminal (uint8_t), data_length (int32_t), game_length (int32_t), return (float), is_compressed (uint8_t), game record
+// the game record is the rest of the payload, so that the writer thread of an actor can compress it without parsing the other fields
+constexpr size_t kWireSelfPlayHeaderSize = 15;
+constexpr size_t kWireSelfPlayCompressedOffset = 14;
+
+inline std::string toWireSelfPlayPayload(bool is_terminal, int data_length, int game_length, float game_return, const std::string& game_record)
+{
+    RecordBuilder builder;
+    builder.write(static_cast<uint8_t>(WireMessageType::kSelfPlay));
+    builder.write(static_cast<uint8_t>(is_terminal));
+    builder.write(static_cast<int32_t>(data_length));
+    builder.write(static_cast<int32_t>(game_length));
+    builder.write(game_return);
+    builder.write(static_cast<uint8_t>(0));
+    builder.write(game_record.data(), game_record.size());
+    return builder.getRecord();
+}
+
+// compresses the game record of a self-play payload by gzip, the hex encoding used by text messages is not needed in frames
+inline std::string compressWireSelfPlayPayload(const std::string& payload)
+{
+    std::string compressed_payload = payload.substr(0, kWireSelfPlayHeaderSize);
+    compressed_payload[kWireSelfPlayCompressedOffset] = 1;
+    compressed_payload += compressToBinaryString(payload.substr(kWireSelfPlayHeaderSize));
+    return compressed_payload;
+}
+
+inline std::string toWireFrame(const std::string& payload)
+{
+    uint32_t payload_size = payload.size();
+    std::string frame(kWireFrameMagic, sizeof(kWireFrameMagic));
+    frame.append(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+    frame.append(payload);
+    return frame;
+}
+
+// returns false if the header is not a valid frame header
+inline bool parseWireFrameHeader(const char* header, uint32_t& payload_size)
+{
+    if (std::memcmp(header, kWireFrameMagic, sizeof(kWireFrameMagic)) != 0) { return false; }
+    std::memcpy(&payload_size, header + sizeof(kWireFrameMagic), sizeof(payload_size));
+    return payload_size <= kWireFrameMaxPayloadSize;
+}
+
+} // namespace minizero::utils
@@ -1,12 +1,18 @@
 #include "zero_server.h"
+#include "environment.h"
 #include "git_info.h"
 #include "random.h"
 #include "utils.h"
+#include "wire_frame.h"
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
+#include <cstdlib>
+#include <fcntl.h>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <string>
+#include <unistd.h>
 #include <vector>
 
 namespace minizero::zero {
@@ -14,6 +20,73 @@ namespace minizero::zero {
 using namespace minizero;
 using namespace minizero::utils;
 
+// flushes a closed file from the page cache to the disk
+static void syncFile(const std::string& file_name)
+{
+    int fd = ::open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) { return; }
+    ::fsync(fd);
+    ::close(fd);
+}
+
+void ZeroSelfPlayWriter::open(const std::string& file_name_prefix, bool compress, bool write_binary_records)
+{
+    close();
+    compress_ = compress;
+    num_file_bytes_ = 0;
+    num_written_bytes_ = 0;
+    write_microseconds_ = 0;
+    delimiter_ = "\n";
+    sgf_file_name_ = file_name_prefix + (compress_ ? ".sgf.gz" : ".sgf");
+    record_file_name_ = (write_binary_records ? file_name_prefix + ".bin" : "");
+    sgf_file_.open(sgf_file_name_, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (write_binary_records) { record_file_.open(record_file_name_); }
+    startThread();
+}
+
+void ZeroSelfPlayWriter::close()
+{
+    if (!thread_) { return; }
+    stop();
+    sgf_file_.close();
+    record_file_.close();
+
+    // files are synced once per iteration instead of once per game
+    syncFile(sgf_file_name_);
+    if (!record_file_name_.empty()) { syncFile(record_file_name_); }
+}
+
+void ZeroSelfPlayWriter::writeLine(const std::string& line)
+{
+    if (compress_) {
+        uncompressed_lines_ += line;
+        uncompressed_lines_ += delimiter_;
+    } else {
+        sgf_file_ << line << delimiter_;
+        num_file_bytes_ += line.size() + delimiter_.size();
+    }
+
+    if (record_file_.isOpen()) {
+        // the end mark of a terminal game is not a part of its sgf
+        EnvironmentLoader env_loader;
+        const size_t sgf_size = line.size() - (boost::ends_with(line, " #") ? 2 : 0);
+        if (env_loader.loadFromString(line.substr(0, sgf_size))) { record_file_.write(env_loader.toBinaryString()); }
+    }
+}
+
+void ZeroSelfPlayWriter::flush()
+{
+    if (compress_ && !uncompressed_lines_.empty()) {
+        // each flush writes a complete gzip member, so that the learner can read the games from a file that is still being written
+        // the fastest level keeps the writer ahead of the incoming games, which still saves more than half of the space
+        std::string compressed_lines = compressToBinaryString(uncompressed_lines_, boost::iostreams::zlib::best_speed);
+        sgf_file_.write(compressed_lines.data(), compressed_lines.size());
+        num_file_bytes_ += compressed_lines.size();
+        uncompressed_lines_.clear();
+    }
+    sgf_file_.flush();
+}
+
 void ZeroLogger::createLog()
 {
     std::string worker_file_name = config::zero_training_directory + "/Worker.log";
@@ -27,34 +100,134 @@ void ZeroLogger::createLog()
     }
     worker_log_ << std::endl;
     training_log_ << std::endl;
+    worker_log_writer_.start(worker_log_);
+    training_log_writer_.start(training_log_);
+    stderr_writer_.start(std::cerr);
     addTrainingLog("[Version] " + std::string(GIT_SHORT_HASH));
 }
 
-void ZeroLogger::addLog(const std::string& log_str, std::fstream& log_file)
+void ZeroLogger::close()
 {
-    log_file << TimeSystem::getTimeString("[Y/m/d_H:i:s.f] ") << log_str << std::endl;
-    std::cerr << TimeSystem::getTimeString("[Y/m/d_H:i:s.f] ") << log_str << std::endl;
+    // writes all remaining games and logs
+    self_play_writer_.close();
+    worker_log_writer_.stop();
+    training_log_writer_.stop();
+    stderr_writer_.stop();
 }
 
-ZeroSelfPlayData::ZeroSelfPlayData(std::string input_data)
+void ZeroLogger::addLog(const std::string& log_str, utils::AsyncWriter& log_writer)
 {
-    // format: Selfplay is_terminal data_length game_length return game_record
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove Selfplay
-    is_terminal_ = (input_data.substr(0, input_data.find(" ")) == "true");
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove is_terminal
-    data_length_ = std::stoi(input_data.substr(0, input_data.find(" ")));
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove data_length
-    game_length_ = std::stoi(input_data.substr(0, input_data.find(" ")));
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove game_length
-    return_ = std::stof(input_data.substr(0, input_data.find(" ")));
-    input_data = input_data.substr(input_data.find(" ") + 1); // remove return
-    game_record_ = input_data.substr(0, input_data.find(" "));
+    std::string log_line = TimeSystem::getTimeString("[Y/m/d_H:i:s.f] ") + log_str;
+    log_writer.write(log_line);
+    stderr_writer_.write(std::move(log_line));
 }
 
-bool ZeroWorkerSharedData::getSelfPlayData(ZeroSelfPlayData& sp_data)
+bool ZeroSelfPlayData::loadFromString(const std::string& message)
 {
-    if (sp_data_queue_.empty()) { return false; }
+    // format: SelfPlay is_terminal data_length game_length return game_record #
+    // fields are located by their offsets, so that the game record is the only copy made from the message
+    size_t field_starts[6]; // is_terminal, data_length, game_length, return, game_record, end mark
+    size_t pos = 0;
+    for (size_t& field_start : field_starts) {
+        if ((pos = message.find(' ', pos)) == std::string::npos) { return false; }
+        field_start = ++pos;
+    }
+
+    // the end mark must directly follow the game record, which also rejects several games merged into one message
+    if (message.compare(field_starts[5], std::string::npos, "#") != 0) { return false; }
+    is_terminal_ = (message.compare(field_starts[0], field_starts[1] - 1 - field_starts[0], "true") == 0);
+    data_length_ = std::strtol(message.c_str() + field_starts[1], nullptr, 10);
+    game_length_ = std::strtol(message.c_str() + field_starts[2], nullptr, 10);
+    return_ = std::strtof(message.c_str() + field_starts[3], nullptr);
+    game_record_.assign(message, field_starts[4], field_starts[5] - 1 - field_starts[4]);
+    return true;
+}
+
+bool ZeroSelfPlayData::loadFromBinary(const char* data, size_t size)
+{
+    // format: see utils::toWireSelfPlayPayload
+    utils::RecordParser parser(data, size);
+    uint8_t type = 0, is_terminal = 0, is_compressed = 0;
+    int32_t data_length = 0, game_length = 0;
+    if (!parser.read(type) || type != static_cast<uint8_t>(utils::WireMessageType::kSelfPlay) ||
+        !parser.read(is_terminal) || !parser.read(data_length) || !parser.read(game_length) || !parser.read(return_) || !parser.read(is_compressed)) {
+        return false;
+    }
+
+    is_terminal_ = is_terminal;
+    data_length_ = data_length;
+    game_length_ = game_length;
+    game_record_.assign(data + utils::kWireSelfPlayHeaderSize, size - utils::kWireSelfPlayHeaderSize);
+    if (is_compressed) {
+        try {
+            game_record_ = utils::decompressBinaryString(game_record_);
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ZeroWorkerSharedData::startParsing(int num_threads)
+{
+    for (int i = 0; i < std::max(1, num_threads); ++i) {
+        parse_threads_.create_thread(boost::bind(&boost::asio::io_service::run, &parse_io_service_));
+    }
+}
+
+void ZeroWorkerSharedData::stopParsing()
+{
+    parse_io_service_.stop();
+    parse_threads_.join_all();
+}
+
+void ZeroWorkerSharedData::handleSelfPlayMessage(const std::string& message)
+{
+    // compressed self-play games, format: SelfPlayGzip hex_string_of_gzip_binary
+    if (message.rfind("SelfPlayGzip ", 0) == 0) {
+        std::string game;
+        try {
+            game = utils::decompressString(message.substr(message.find(" ") + 1));
+        } catch (const std::exception&) {
+            logger_.addWorkerLog("[Worker Error] Receive broken compressed self-play games");
+            return;
+        }
+        handleSelfPlayMessage(game);
+        return;
+    }
 
+    ZeroSelfPlayData sp_data; // create data before lock for efficiency
+    if (message.rfind("SelfPlay ", 0) != 0 || !sp_data.loadFromString(message)) {
+        logger_.addWorkerLog("[Worker Error] Receive broken self-play games");
+        return;
+    }
+    addSelfPlayData(sp_data);
+}
+
+void ZeroWorkerSharedData::handleSelfPlayFrame(const std::string& payload)
+{
+    ZeroSelfPlayData sp_data; // create data before lock for efficiency
+    if (!sp_data.loadFromBinary(payload.data(), payload.size())) {
+        logger_.addWorkerLog("[Worker Error] Receive broken self-play frames");
+        return;
+    }
+    addSelfPlayData(sp_data);
+}
+
+void ZeroWorkerSharedData::addSelfPlayData(const ZeroSelfPlayData& sp_data)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    sp_data_queue_.push(sp_data);
+    cv_.notify_all();
+
+    // print number of games if the queue already received many games in buffer
+    if (sp_data_queue_.size() % std::max(1, static_cast<int>(config::zero_num_games_per_iteration * 0.25)) == 0) {
+        logger_.addTrainingLog("[SelfPlay Game Buffer] " + std::to_string(sp_data_queue_.size()) + " games");
+    }
+}
+
+bool ZeroWorkerSharedData::getSelfPlayData(ZeroSelfPlayData& sp_data)
+{
     boost::lock_guard<boost::mutex> lock(mutex_);
     if (sp_data_queue_.empty()) { return false; }
     sp_data = sp_data_queue_.front();
@@ -62,12 +235,71 @@ bool ZeroWorkerSharedData::getSelfPlayData(ZeroSelfPlayData& sp_data)
     return true;
 }
 
+// returns false if woken up because the state of workers changed, e.g., idle workers are waiting for jobs
+bool ZeroWorkerSharedData::waitSelfPlayData(ZeroSelfPlayData& sp_data)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !sp_data_queue_.empty() || is_worker_state_changed_; });
+    if (is_worker_state_changed_) {
+        is_worker_state_changed_ = false;
+        return false;
+    }
+    sp_data = std::move(sp_data_queue_.front());
+    sp_data_queue_.pop();
+    return true;
+}
+
+// returns false if woken up because the state of workers changed before the optimization finishes
+bool ZeroWorkerSharedData::waitOptimizationDone()
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !is_optimization_phase_ || is_worker_state_changed_; });
+    is_worker_state_changed_ = false;
+    return !is_optimization_phase_;
+}
+
+void ZeroWorkerSharedData::notifyWorkerStateChanged()
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    is_worker_state_changed_ = true;
+    cv_.notify_all();
+}
+
+void ZeroWorkerSharedData::setOptimizationPhase(bool is_optimization_phase)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    is_optimization_phase_ = is_optimization_phase;
+    cv_.notify_all();
+}
+
 bool ZeroWorkerSharedData::isOptimizationPahse()
 {
     boost::lock_guard<boost::mutex> lock(mutex_);
     return is_optimization_phase_;
 }
 
+// returns the id of the new job, which is attached to its train commands when several op workers train together
+int ZeroWorkerSharedData::startOptimizationJob(int num_op_workers)
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    num_optimization_workers_ = num_op_workers;
+    num_optimization_done_workers_ = 0;
+    return ++optimization_job_id_;
+}
+
+int ZeroWorkerSharedData::getOptimizationJobId()
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return optimization_job_id_;
+}
+
+// returns the number of op workers of the running job, which is 0 once the job finishes
+int ZeroWorkerSharedData::getNumOptimizationWorkers()
+{
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    return num_optimization_workers_;
+}
+
 int ZeroWorkerSharedData::getModelIetration()
 {
     boost::lock_guard<boost::mutex> lock(mutex_);
@@ -76,6 +308,12 @@ int ZeroWorkerSharedData::getModelIetration()
 
 void ZeroWorkerHandler::handleReceivedMessage(const std::string& message)
 {
+    // self-play games (SelfPlay or SelfPlayGzip) are parsed by the parse threads, so that the io threads are never blocked by large games
+    if (message.rfind("SelfPlay", 0) == 0) {
+        shared_data_.parse_io_service_.post(boost::bind(&ZeroWorkerSharedData::handleSelfPlayMessage, &shared_data_, message));
+        return;
+    }
+
     std::vector<std::string> args;
     boost::split(args, message, boost::is_any_of(" "), boost::token_compress_on);
 
@@ -85,16 +323,19 @@ void ZeroWorkerHandler::handleReceivedMessage(const std::string& message)
         boost::lock_guard<boost::mutex> lock(shared_data_.worker_mutex_);
         shared_data_.logger_.addWorkerLog("[Worker Connection] " + getName() + " " + getType());
         if (type_ == "sp") {
+            // workers that support binary frames announce it after their type, format: Info name sp binary
+            bool use_binary_protocol = (config::zero_server_binary_protocol && args.size() > 3 && args[3] == "binary");
             std::string job_command = "";
             job_command += "Job_SelfPlay ";
             job_command += config::zero_training_directory + " ";
             job_command += "nn_file_name=" + config::zero_training_directory + "/model/weight_iter_" + std::to_string(shared_data_.getModelIetration()) + ".pt";
             job_command += ":program_auto_seed=false:program_seed=" + std::to_string(utils::Random::randInt());
+            if (use_binary_protocol) { job_command += ":zero_actor_binary_protocol=true"; }
             write(job_command);
             syncConfig();
         } else if (type_ == "op") {
-            if (shared_data_.num_op_worker_ >= 1) {
-                shared_data_.logger_.addWorkerLog("[Worker Error] Receive multiple op workers");
+            if (shared_data_.num_op_worker_ >= config::zero_server_num_op_workers) {
+                shared_data_.logger_.addWorkerLog("[Worker Error] Receive more than " + std::to_string(config::zero_server_num_op_workers) + " op workers");
                 shared_data_.logger_.addWorkerLog("[Worker Disconnection] " + getName() + " " + getType());
                 ConnectionHandler::close();
             } else {
@@ -107,24 +348,30 @@ void ZeroWorkerHandler::handleReceivedMessage(const std::string& message)
             ConnectionHandler::close();
         }
         is_idle_ = true;
-    } else if (args[0] == "SelfPlay") {
-        if (message.find("SelfPlay", message.find("SelfPlay", 0) + 1) != std::string::npos || message.back() != '#') {
-            shared_data_.logger_.addWorkerLog("[Worker Error] Receive broken self-play games");
-            return;
-        }
-
-        ZeroSelfPlayData sp_data(message); // create data before lock for efficiency
-        boost::lock_guard<boost::mutex> lock(shared_data_.mutex_);
-        shared_data_.sp_data_queue_.push(sp_data);
-
-        // print number of games if the queue already received many games in buffer
-        if (shared_data_.sp_data_queue_.size() % std::max(1, static_cast<int>(config::zero_num_games_per_iteration * 0.25)) == 0) {
-            shared_data_.logger_.addTrainingLog("[SelfPlay Game Buffer] " + std::to_string(shared_data_.sp_data_queue_.size()) + " games");
-        }
+        shared_data_.notifyWorkerStateChanged();
     } else if (args[0] == "Optimization_Done") {
+        // format: Optimization_Done model_iteration [job_id]
+        // the optimization finishes when all op workers of the job are done, whose models are the same; workers of a previous job only become idle
+        // also wakes the server collecting games, which lets the self-play workers load the new model in asynchronous optimization
+        boost::lock_guard<boost::mutex> worker_lock(shared_data_.worker_mutex_);
         boost::lock_guard<boost::mutex> lock(shared_data_.mutex_);
-        shared_data_.model_iteration_ = stoi(args[1]);
-        shared_data_.is_optimization_phase_ = false;
+        is_idle_ = true;
+        bool is_current_job = (args.size() < 3 || stoi(args[2]) == shared_data_.optimization_job_id_);
+        if (is_current_job && ++shared_data_.num_optimization_done_workers_ == shared_data_.num_optimization_workers_) {
+            shared_data_.model_iteration_ = stoi(args[1]);
+            shared_data_.num_optimization_workers_ = 0;
+            shared_data_.is_optimization_phase_ = false;
+        }
+        shared_data_.is_worker_state_changed_ = true;
+        shared_data_.cv_.notify_all();
+    } else if (args[0] == "Optimization_Failed") {
+        // format: Optimization_Failed job_id
+        // the op worker leaves the group after a collective operation of the job fails or times out, e.g., another worker of the group left
+        boost::lock_guard<boost::mutex> lock(shared_data_.worker_mutex_);
+        shared_data_.logger_.addWorkerLog("[Worker Error] " + getName() + " " + getType() + " failed optimization job " + args[1]);
+        is_idle_ = true;
+        optimization_job_id_ = 0;
+        shared_data_.notifyWorkerStateChanged();
     } else {
         std::string error_message = message;
         std::replace(error_message.begin(), error_message.end(), '\r', ' ');
@@ -134,11 +381,23 @@ void ZeroWorkerHandler::handleReceivedMessage(const std::string& message)
     }
 }
 
+void ZeroWorkerHandler::handleReceivedFrame(const char* payload, size_t size)
+{
+    if (size > 0 && payload[0] == static_cast<char>(utils::WireMessageType::kSelfPlay)) {
+        shared_data_.parse_io_service_.post(boost::bind(&ZeroWorkerSharedData::handleSelfPlayFrame, &shared_data_, std::string(payload, size)));
+        return;
+    }
+
+    shared_data_.logger_.addWorkerLog("[Worker Error] Receive unknown frame");
+    close();
+}
+
 void ZeroWorkerHandler::close()
 {
     if (isClosed()) { return; }
 
     boost::lock_guard<boost::mutex> lock(shared_data_.worker_mutex_);
+    if (isClosed()) { return; } // closed by another io thread while waiting for the lock
     shared_data_.logger_.addWorkerLog("[Worker Disconnection] " + getName() + " " + getType());
     ConnectionHandler::close();
     if (getType() == "op") { --shared_data_.num_op_worker_; }
@@ -158,8 +417,24 @@ void ZeroServer::run()
 
     for (iteration_ = config::zero_start_iteration; iteration_ <= config::zero_end_iteration; ++iteration_) {
         syncConfig();
-        selfPlay();
-        optimization();
+        shared_data_.logger_.addTrainingLog("[Iteration] =====" + std::to_string(iteration_) + "=====");
+        if (config::zero_server_async_optimization) {
+            // the previous iterations are optimized while self-play keeps generating games with the latest model
+            if (iteration_ > config::zero_start_iteration) { startOptimization(iteration_ - 1); }
+            selfPlay();
+            if (iteration_ > config::zero_start_iteration) { finishOptimization(); }
+            updateSelfPlayModel();
+        } else {
+            selfPlay();
+            optimization();
+        }
+    }
+
+    // the games of the last iteration are optimized after self-play stops
+    if (config::zero_server_async_optimization && config::zero_start_iteration <= config::zero_end_iteration) {
+        stopJob("sp");
+        startOptimization(config::zero_end_iteration);
+        finishOptimization();
     }
 
     close();
@@ -177,34 +452,44 @@ void ZeroServer::initialize()
     shared_data_.num_op_worker_ = 0;
     shared_data_.model_iteration_ = stoi(nn_file_name);
     shared_data_.updated_conf_str_ = getUpdatedConfig();
+    self_play_model_iteration_ = shared_data_.model_iteration_;
+    optimization_group_prefix_ = "op_group_" + TimeSystem::getTimeString("YmdHisf");
 }
 
 void ZeroServer::selfPlay()
 {
     // setup
-    std::string self_play_file_name = config::zero_training_directory + "/sgf/" + std::to_string(iteration_) + ".sgf";
-    if (config::zero_num_games_per_iteration > 0) { shared_data_.logger_.getSelfPlayFileStream().open(self_play_file_name.c_str(), std::ios::out); }
-    shared_data_.logger_.addTrainingLog("[Iteration] =====" + std::to_string(iteration_) + "=====");
+    std::string self_play_file_name_prefix = config::zero_training_directory + "/sgf/" + std::to_string(iteration_);
+    ZeroSelfPlayWriter& self_play_writer = shared_data_.logger_.getSelfPlayWriter();
+    if (config::zero_num_games_per_iteration > 0) { self_play_writer.open(self_play_file_name_prefix, config::zero_server_compress_self_play_records, config::zero_server_write_binary_records); }
     shared_data_.logger_.addTrainingLog("[SelfPlay] Start " + std::to_string(shared_data_.getModelIetration()));
 
     std::vector<int> game_lengths;
     std::vector<float> game_returns;
+    std::map<int, int> num_model_games; // the number of games generated by each model iteration
     int num_collect_game = 0, total_data_length = 0;
+    broadcastSelfPlayJob();
     while (num_collect_game < config::zero_num_games_per_iteration) {
-        broadcastSelfPlayJob();
-
-        // read one selfplay game
+        // wait for one selfplay game, idle workers are only dispatched when the state of workers changed
         ZeroSelfPlayData sp_data;
-        if (!shared_data_.getSelfPlayData(sp_data)) {
-            boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+        if (!shared_data_.waitSelfPlayData(sp_data)) {
+            broadcastSelfPlayJob();
+            if (config::zero_server_async_optimization) {
+                // running workers load the new model once the optimization finishes, and a reconnected op worker gets the job again
+                updateSelfPlayModel();
+                if (shared_data_.isOptimizationPahse()) { broadcastOptimizationJob(optimization_job_command_); }
+            }
             continue;
-        } else if (!config::zero_server_accept_different_model_games && sp_data.game_record_.find("weight_iter_" + std::to_string(shared_data_.getModelIetration())) == std::string::npos) {
+        }
+
+        const size_t model_pos = sp_data.game_record_.find("weight_iter_");
+        const int game_model_iteration = (model_pos == std::string::npos ? -1 : std::atoi(sp_data.game_record_.c_str() + model_pos + std::string("weight_iter_").size()));
+        if (!config::zero_server_accept_different_model_games && game_model_iteration != shared_data_.getModelIetration()) {
             // discard previous self-play games
             continue;
         }
 
-        // save record
-        shared_data_.logger_.getSelfPlayFileStream() << sp_data.game_record_ << (sp_data.is_terminal_ ? " #" : "") << std::endl;
+        ++num_model_games[game_model_iteration];
         ++num_collect_game;
         total_data_length += sp_data.data_length_;
         if (sp_data.is_terminal_) {
@@ -212,6 +497,10 @@ void ZeroServer::selfPlay()
             game_returns.push_back(sp_data.return_);
         }
 
+        // save record, which is written to files by the writer thread
+        if (sp_data.is_terminal_) { sp_data.game_record_ += " #"; }
+        self_play_writer.write(std::move(sp_data.game_record_));
+
         // display progress
         if (num_collect_game % std::max(1, static_cast<int>(config::zero_num_games_per_iteration * 0.25)) == 0) {
             shared_data_.logger_.addTrainingLog("[SelfPlay Progress] " +
@@ -220,9 +509,19 @@ void ZeroServer::selfPlay()
         }
     }
 
-    stopJob("sp");
-    if (config::zero_num_games_per_iteration > 0) { shared_data_.logger_.getSelfPlayFileStream().close(); }
+    // in asynchronous optimization, workers keep generating games for the next iteration
+    if (!config::zero_server_async_optimization) { stopJob("sp"); }
+    self_play_writer.close();
     shared_data_.logger_.addTrainingLog("[SelfPlay] Finished.");
+    if (num_model_games.size() > 1) {
+        std::string model_games;
+        for (const auto& m : num_model_games) { model_games += " " + std::to_string(m.first) + ":" + std::to_string(m.second); }
+        shared_data_.logger_.addTrainingLog("[SelfPlay # Games of Models]" + model_games);
+    }
+    if (num_collect_game > 0) {
+        shared_data_.logger_.addTrainingLog("[SelfPlay Written Bytes] " + std::to_string(self_play_writer.getNumWrittenBytes()) + " (" + std::to_string(self_play_writer.getNumFileBytes()) + " in sgf file)");
+        shared_data_.logger_.addTrainingLog("[SelfPlay Write Throughput] " + std::to_string(self_play_writer.getNumWrittenBytes() / 1e6 / std::max(self_play_writer.getWriteSeconds(), 1e-6)) + " MB/s");
+    }
     if (!game_lengths.empty()) {
         shared_data_.logger_.addTrainingLog("[SelfPlay # Finished Games] " + std::to_string(game_lengths.size()));
         shared_data_.logger_.addTrainingLog("[SelfPlay Min. Game Lengths] " + std::to_string(*std::min_element(game_lengths.begin(), game_lengths.end())));
@@ -250,28 +549,83 @@ void ZeroServer::broadcastSelfPlayJob()
 }
 
 void ZeroServer::optimization()
+{
+    startOptimization(iteration_);
+    finishOptimization();
+}
+
+void ZeroServer::startOptimization(int end_iteration)
 {
     shared_data_.logger_.addTrainingLog("[Optimization] Start.");
 
-    std::string job_command = "train ";
-    job_command += "weight_iter_" + std::to_string(shared_data_.getModelIetration()) + ".pkl";
-    job_command += " " + std::to_string(std::max(1, iteration_ - config::zero_replay_buffer + 1));
-    job_command += " " + std::to_string(iteration_);
-
-    shared_data_.is_optimization_phase_ = true;
-    while (shared_data_.isOptimizationPahse()) {
-        boost::lock_guard<boost::mutex> lock(worker_mutex_);
-        for (auto worker : connections_) {
-            if (!worker->isIdle() || worker->getType() != "op") { continue; }
-            worker->setIdle(false);
-            worker->write(job_command);
-        }
-    }
+    optimization_job_command_ = "train ";
+    optimization_job_command_ += "weight_iter_" + std::to_string(shared_data_.getModelIetration()) + ".pkl";
+    optimization_job_command_ += " " + std::to_string(std::max(1, end_iteration - config::zero_replay_buffer + 1));
+    optimization_job_command_ += " " + std::to_string(end_iteration);
+
+    shared_data_.setOptimizationPhase(true);
+    broadcastOptimizationJob(optimization_job_command_);
+}
+
+void ZeroServer::finishOptimization()
+{
+    // dispatch the job again only when an op worker (re)connects before the optimization finishes
+    while (!shared_data_.waitOptimizationDone()) { broadcastOptimizationJob(optimization_job_command_); }
     stopJob("op");
 
     shared_data_.logger_.addTrainingLog("[Optimization] Finished.");
 }
 
+void ZeroServer::broadcastOptimizationJob(const std::string& job_command)
+{
+    boost::lock_guard<boost::mutex> lock(worker_mutex_);
+    if (!shared_data_.isOptimizationPahse()) { return; } // the job finished before getting the lock
+
+    const int running_job_id = shared_data_.getOptimizationJobId();
+    int num_running_job_workers = 0;
+    std::vector<boost::shared_ptr<ZeroWorkerHandler>> idle_op_workers;
+    for (auto worker : connections_) {
+        if (worker->isClosed() || worker->getType() != "op") { continue; }
+        if (worker->getOptimizationJobId() == running_job_id) { ++num_running_job_workers; }
+        if (worker->isIdle()) { idle_op_workers.push_back(worker); }
+    }
+
+    // if an op worker left or failed the running job, the others cannot finish it without that worker, so the job is dispatched again to a new group
+    // the other workers of the old group stay busy until their collective operations time out and they report the failure
+    if (num_running_job_workers < shared_data_.getNumOptimizationWorkers()) {
+        shared_data_.logger_.addTrainingLog("[Optimization] Restart since an op worker left.");
+        shared_data_.startOptimizationJob(0);
+    }
+
+    // several op workers train together in data parallel, where each one gets its rank in the group and loads a shard of the replay buffer
+    // the group name is unique to each job, which names the file that the workers of the group rendezvous through
+    // format: train model_file start_iteration end_iteration [rank num_op_workers job_id group_name]
+    const int num_op_workers = config::zero_server_num_op_workers;
+    if (static_cast<int>(idle_op_workers.size()) < num_op_workers) { return; }
+    const int job_id = shared_data_.startOptimizationJob(num_op_workers);
+    const std::string group_args = std::to_string(num_op_workers) + " " + std::to_string(job_id) + " " + optimization_group_prefix_ + "_" + std::to_string(iteration_) + "_" + std::to_string(job_id);
+    for (int rank = 0; rank < num_op_workers; ++rank) {
+        idle_op_workers[rank]->setIdle(false);
+        idle_op_workers[rank]->setOptimizationJobId(job_id);
+        idle_op_workers[rank]->write(num_op_workers == 1 ? job_command : job_command + " " + std::to_string(rank) + " " + group_args);
+    }
+}
+
+void ZeroServer::updateSelfPlayModel()
+{
+    // running self-play workers load the model without stopping, so their unfinished games continue with the new model
+    int model_iteration = shared_data_.getModelIetration();
+    if (model_iteration == self_play_model_iteration_) { return; }
+    self_play_model_iteration_ = model_iteration;
+    shared_data_.logger_.addTrainingLog("[SelfPlay] Update model " + std::to_string(model_iteration));
+
+    boost::lock_guard<boost::mutex> lock(worker_mutex_);
+    for (auto& worker : connections_) {
+        if (worker->isIdle() || worker->getType() != "sp") { continue; }
+        worker->write("load_model " + config::zero_training_directory + "/model/weight_iter_" + std::to_string(model_iteration) + ".pt");
+    }
+}
+
 std::string ZeroServer::getUpdatedConfig()
 {
     std::string job_command = "";
@@ -310,6 +664,7 @@ void ZeroServer::close()
 {
     boost::lock_guard<boost::mutex> lock(worker_mutex_);
     for (auto worker : connections_) { worker->write("quit"); }
+    shared_data_.logger_.close();
     exit(0);
 }
 
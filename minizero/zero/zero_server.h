@@ -1,7 +1,9 @@
 #pragma once
 
+#include "async_writer.h"
 #include "base_server.h"
 #include "configuration.h"
+#include "record_file.h"
 #include "time_system.h"
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/thread.hpp>
@@ -12,21 +14,55 @@
 
 namespace minizero::zero {
 
+// saves the self-play games of an iteration on a dedicated thread, so that the server never waits for the disk while collecting games
+// each game is a line of sgf/[iteration].sgf (or a gzip-compressed sgf/[iteration].sgf.gz), and optionally a record of sgf/[iteration].bin
+class ZeroSelfPlayWriter : public utils::AsyncWriter {
+public:
+    ZeroSelfPlayWriter()
+        : compress_(false),
+          num_file_bytes_(0) {}
+
+    ~ZeroSelfPlayWriter() { close(); }
+
+    void open(const std::string& file_name_prefix, bool compress, bool write_binary_records);
+    void close();
+
+    // the bytes written to the sgf file, which are fewer than getNumWrittenBytes() if compressed
+    inline uint64_t getNumFileBytes() const { return num_file_bytes_; }
+
+protected:
+    void writeLine(const std::string& line) override;
+    void flush() override;
+
+    bool compress_;
+    uint64_t num_file_bytes_;
+    std::string sgf_file_name_;
+    std::string record_file_name_;
+    std::ofstream sgf_file_;
+    std::string uncompressed_lines_; // the lines written since the last flush, which are compressed into one gzip member
+    utils::RecordFileWriter record_file_;
+};
+
 class ZeroLogger {
 public:
     ZeroLogger() {}
     void createLog();
+    void close();
 
-    inline void addWorkerLog(const std::string& log_str) { addLog(log_str, worker_log_); }
-    inline void addTrainingLog(const std::string& log_str) { addLog(log_str, training_log_); }
-    inline std::fstream& getSelfPlayFileStream() { return self_play_game_; }
+    inline void addWorkerLog(const std::string& log_str) { addLog(log_str, worker_log_writer_); }
+    inline void addTrainingLog(const std::string& log_str) { addLog(log_str, training_log_writer_); }
+    inline ZeroSelfPlayWriter& getSelfPlayWriter() { return self_play_writer_; }
 
 private:
-    void addLog(const std::string& log_str, std::fstream& log_file);
+    void addLog(const std::string& log_str, utils::AsyncWriter& log_writer);
 
+    // logs are written by their own threads, which are stopped before the files are closed
     std::fstream worker_log_;
     std::fstream training_log_;
-    std::fstream self_play_game_;
+    utils::AsyncWriter worker_log_writer_;
+    utils::AsyncWriter training_log_writer_;
+    utils::AsyncWriter stderr_writer_;
+    ZeroSelfPlayWriter self_play_writer_;
 };
 
 class ZeroSelfPlayData {
@@ -38,21 +74,47 @@ public:
     std::string game_record_;
 
     ZeroSelfPlayData() {}
-    ZeroSelfPlayData(std::string input_data);
+    bool loadFromString(const std::string& message);
+    bool loadFromBinary(const char* data, size_t size);
 };
 
 class ZeroWorkerSharedData {
 public:
     ZeroWorkerSharedData(boost::mutex& worker_mutex)
-        : worker_mutex_(worker_mutex)
+        : is_optimization_phase_(false),
+          is_worker_state_changed_(false),
+          optimization_job_id_(0),
+          num_optimization_workers_(0),
+          num_optimization_done_workers_(0),
+          worker_mutex_(worker_mutex),
+          parse_work_(parse_io_service_)
     {
     }
 
+    ~ZeroWorkerSharedData() { stopParsing(); }
+
+    void startParsing(int num_threads);
+    void stopParsing();
+    void handleSelfPlayMessage(const std::string& message);
+    void handleSelfPlayFrame(const std::string& payload);
+    void addSelfPlayData(const ZeroSelfPlayData& sp_data);
     bool getSelfPlayData(ZeroSelfPlayData& sp_data);
+    bool waitSelfPlayData(ZeroSelfPlayData& sp_data);
+    bool waitOptimizationDone();
+    void notifyWorkerStateChanged();
+    void setOptimizationPhase(bool is_optimization_phase);
     bool isOptimizationPahse();
+    int startOptimizationJob(int num_op_workers);
+    int getOptimizationJobId();
+    int getNumOptimizationWorkers();
     int getModelIetration();
 
     bool is_optimization_phase_;
+    bool is_worker_state_changed_;
+    // the op workers of an optimization job train together, and the job is done when all of them are done
+    int optimization_job_id_;
+    int num_optimization_workers_;
+    int num_optimization_done_workers_;
     int num_op_worker_;
     int total_games_;
     int model_iteration_;
@@ -60,7 +122,11 @@ public:
     std::string updated_conf_str_;
     std::queue<ZeroSelfPlayData> sp_data_queue_;
     boost::mutex mutex_;
+    boost::condition_variable cv_; // notified with mutex_ when games are received, workers become idle, or the optimization finishes
     boost::mutex& worker_mutex_;
+    boost::asio::io_service parse_io_service_;
+    boost::asio::io_service::work parse_work_;
+    boost::thread_group parse_threads_;
 };
 
 class ZeroWorkerHandler : public utils::ConnectionHandler {
@@ -68,21 +134,26 @@ public:
     ZeroWorkerHandler(boost::asio::io_service& io_service, ZeroWorkerSharedData& shared_data)
         : ConnectionHandler(io_service),
           is_idle_(false),
+          optimization_job_id_(0),
           shared_data_(shared_data)
     {
     }
 
     void handleReceivedMessage(const std::string& message) override;
+    void handleReceivedFrame(const char* payload, size_t size) override;
     void close() override;
     void syncConfig();
 
     inline bool isIdle() const { return is_idle_; }
     inline std::string getName() const { return name_; }
     inline std::string getType() const { return type_; }
+    inline int getOptimizationJobId() const { return optimization_job_id_; }
     inline void setIdle(bool is_idle) { is_idle_ = is_idle; }
+    inline void setOptimizationJobId(int job_id) { optimization_job_id_ = job_id; }
 
 private:
     bool is_idle_;
+    int optimization_job_id_; // the optimization job of an op worker, which is 0 after the worker fails the job
     std::string name_;
     std::string type_;
     ZeroWorkerSharedData& shared_data_;
@@ -91,10 +162,11 @@ private:
 class ZeroServer : public utils::BaseServer<ZeroWorkerHandler> {
 public:
     ZeroServer()
-        : BaseServer(minizero::config::zero_server_port),
+        : BaseServer(minizero::config::zero_server_port, minizero::config::zero_server_num_io_threads),
           shared_data_(worker_mutex_),
           keep_alive_timer_(io_service_)
     {
+        shared_data_.startParsing(minizero::config::zero_server_num_parse_threads);
         startKeepAlive();
     }
 
@@ -107,6 +179,10 @@ protected:
     virtual void selfPlay();
     virtual void broadcastSelfPlayJob();
     virtual void optimization();
+    virtual void startOptimization(int end_iteration);
+    virtual void finishOptimization();
+    virtual void broadcastOptimizationJob(const std::string& job_command);
+    virtual void updateSelfPlayModel();
     virtual std::string getUpdatedConfig();
     void syncConfig();
     void stopJob(const std::string& job_type);
@@ -115,6 +191,9 @@ protected:
     void startKeepAlive();
 
     int iteration_;
+    int self_play_model_iteration_; // the model used by running self-play workers
+    std::string optimization_job_command_;
+    std::string optimization_group_prefix_; // unique to each server start, so that op groups never reuse the rendezvous files of a previous run
     ZeroWorkerSharedData shared_data_;
     boost::asio::deadline_timer keep_alive_timer_;
 };
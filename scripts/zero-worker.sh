@@ -128,10 +128,15 @@ do
 		echo "connect success"
 		retry_connection_counter=0
 
-		# send info
+		# send info, where self-play workers also announce that the self-play executable can send games in binary frames
 		NAME=$(hostname)"_"$gpu_list
-		echo "Info $NAME $worker_type"
-		echo "Info $NAME $worker_type" 1>&$broker_fd
+		info="Info $NAME $worker_type"
+		if [ "$worker_type" == "sp" ]
+		then
+			info="$info binary"
+		fi
+		echo "$info"
+		echo "$info" 1>&$broker_fd
 
 		while true
 		do